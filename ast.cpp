@@ -0,0 +1,105 @@
+#include <sstream>
+#include <stdexcept>
+#include "ast.h"
+
+using namespace std;
+
+
+void Ast::reset(TokenSpan t) {
+    if (isPart) {
+        if (t.size() > capacity) throw std::runtime_error("AST part is smaller than its input");
+    } else {
+        tokens = t;
+        base = 0;
+        if (t.size() > capacity) {
+            nodeStorage.reset(new AstNode[t.size()]);
+            numberStorage.reset(new double[t.size()]);
+            nodes = nodeStorage.get();
+            numbers = numberStorage.get();
+            capacity = t.size();
+        }
+    }
+    count = 0;
+    numberCount = 0;
+    first = last = NO_NODE;
+}
+
+
+NodeIndex Ast::add(AstKind kind, char op, uint32_t token, NodeIndex left, NodeIndex right) {
+    if (count == capacity) throw std::runtime_error("AST is out of node slots");
+    NodeIndex i = static_cast<NodeIndex>(base + count++);
+    nodes[i] = {kind, op, base + token, left, right};
+    return i;
+}
+
+
+NodeIndex Ast::addNumber(uint32_t token, double value) {
+    NodeIndex constant = static_cast<NodeIndex>(base + numberCount++);
+    numbers[constant] = value;
+    return add(AstKind::Number, 0, token, constant, NO_NODE);
+}
+
+
+void Ast::appendStatement(NodeIndex statement) {
+    if (last == NO_NODE) first = statement;
+    else nodes[last].right = statement;
+    last = statement;
+}
+
+
+void Ast::truncate(size_t nodeCount, size_t constantCount) {
+    count = nodeCount;
+    numberCount = constantCount;
+}
+
+
+void Ast::resetPart(Ast& whole, size_t firstToken, size_t tokenCount) {
+    if (firstToken + tokenCount > whole.capacity) throw std::runtime_error("AST part lies outside the whole tree");
+    nodeStorage.reset();
+    numberStorage.reset();
+    nodes = whole.nodes;
+    numbers = whole.numbers;
+    tokens = whole.tokens;
+    isPart = true;
+    base = static_cast<NodeIndex>(firstToken);
+    capacity = tokenCount;
+    count = numberCount = 0;
+    first = last = NO_NODE;
+}
+
+
+void Ast::appendPart(const Ast& part) {
+    count += part.count;
+    numberCount += part.numberCount;
+    if (part.first == NO_NODE) return;
+    appendStatement(part.first);
+    last = part.last;
+}
+
+
+string Ast::toString() const {
+    string out;
+    for (NodeIndex s = first; s != NO_NODE; s = nodes[s].right) {
+        out += toString(s);
+        out += '\n';
+    }
+    return out;
+}
+
+
+string Ast::toString(NodeIndex i) const {
+    const AstNode& n = nodes[i];
+    switch (n.kind) {
+        case AstKind::Assign:   return "(= " + name(n) + " " + toString(n.left) + ")";
+        case AstKind::Print:    return "(print " + toString(n.left) + ")";
+        case AstKind::Binary:   return string("(") + n.op + " " + toString(n.left) + " " + toString(n.right) + ")";
+        case AstKind::Call:     return "(" + name(n) + " " + toString(n.left) + ")";
+        case AstKind::Number: {
+            ostringstream out;
+            out << number(n);
+            return out.str();
+        }
+        case AstKind::Variable: return name(n);
+    }
+    return "?";
+}
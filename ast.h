@@ -0,0 +1,87 @@
+#ifndef AST_H
+#define AST_H
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+#include "lexical.h"
+
+using namespace std;
+
+// Syntax tree built by Parser::parse(Ast&). Nodes live in one contiguous
+// vector and refer to each other by index, so a tree is a single allocation
+// that is freed (or reused by the next parse) in one go.
+
+typedef uint32_t NodeIndex;
+static const NodeIndex NO_NODE = 0xFFFFFFFF;
+
+enum class AstKind : uint8_t { Assign, Print, Binary, Call, Number, Variable };
+
+struct AstNode {
+    AstKind kind;
+    char op;            // Binary: '+', '-', '*', '/' or '%'
+    uint32_t token;     // source token: target, keyword, operator, name or literal
+    NodeIndex left;     // Assign/Print: value, Binary: lhs, Call: argument,
+                        // Number: index into the constant table
+    NodeIndex right;    // Binary: rhs, Assign/Print: next statement
+};
+static_assert(sizeof(AstNode) == 16, "AstNode should stay at 16 bytes");
+
+class Ast {
+public:
+    // Statements are chained through AstNode::right
+    NodeIndex firstStatement() const { return first; }
+    const AstNode& operator[](NodeIndex i) const { return nodes[i]; }
+    size_t size() const { return count; }
+
+    double number(const AstNode& n) const { return numbers[n.left]; }
+    const string& name(const AstNode& n) const { return tokens[n.token].value; }
+    const Token& token(const AstNode& n) const { return tokens[n.token]; }
+
+    // Fully parenthesized prefix form, e.g. "(= x (+ (* 2 y) 1))"
+    string toString() const;
+    string toString(NodeIndex n) const;
+
+    // Used while parsing. Names refer into `tokens`, which must outlive the
+    // tree. Every node is named after a distinct token, so one slot per
+    // token is always enough and the tree never reallocates.
+    void reset(TokenSpan tokens);
+    NodeIndex add(AstKind kind, char op, uint32_t token, NodeIndex left, NodeIndex right);
+    NodeIndex addNumber(uint32_t token, double value);
+    void appendStatement(NodeIndex statement);
+
+    // Takes back everything added since the tree had nodeCount nodes and
+    // constantCount constants, for a parse that backtracks
+    size_t constantCount() const { return numberCount; }
+    void truncate(size_t nodeCount, size_t constantCount);
+
+    // Building one tree from pieces parsed separately: a part covering
+    // whole's tokens [firstToken, firstToken + tokenCount) writes straight
+    // into whole's slots for those tokens, so parts can be built at the
+    // same time and joining them (appendPart, in source order) copies
+    // nothing. The joined tree's node indices have gaps between parts.
+    // reset() on a part starts the part over within its slots.
+    void resetPart(Ast& whole, size_t firstToken, size_t tokenCount);
+    void appendPart(const Ast& part);
+
+private:
+    // Slots are left uninitialized, so pages are first touched by whichever
+    // thread builds the nodes in them
+    unique_ptr<AstNode[]> nodeStorage;
+    unique_ptr<double[]> numberStorage;
+    AstNode* nodes = nullptr;
+    double* numbers = nullptr;
+    size_t capacity = 0;
+
+    bool isPart = false;
+    NodeIndex base = 0;         // first slot of a part, also its first token
+    size_t count = 0;
+    size_t numberCount = 0;
+
+    TokenSpan tokens;
+    NodeIndex first = NO_NODE;
+    NodeIndex last = NO_NODE;
+};
+
+#endif
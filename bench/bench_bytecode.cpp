@@ -0,0 +1,58 @@
+#include <cstdio>
+#include <exception>
+#include "bench_util.h"
+#include "bytecode.h"
+#include "evaluator.h"
+
+using namespace std;
+
+// A formula-sized program: a few inputs, then the sort of expressions the
+// corpus is made of
+static const char* const FORMULA_PROGRAM =
+    "a = 1.5\nb = 2\nc = 0.5\n"
+    "x = (a + b) * sin(c - 3) % 7\n"
+    "y = x / 2 - sqrt(a * a + b * b)\n"
+    "print(x + y)\n"
+    "z = floor(x * 10) % 4 + abs(c - b) * cos(a)\n"
+    "print(z / (y - 1))\n";
+
+// Time per run of one program in the tree-walking Evaluator, the baseline,
+// and in BytecodeVM, after both have been built once. Built with
+// BYTECODE_SWITCH_DISPATCH as bench_bytecode_switch.
+//
+//   bench_bytecode [program-file]
+int main(int argc, char** argv) {
+    try {
+        shared_ptr<const CompiledLexer> lexer = buildLexer(defaultTokenRules());
+        string source = argc > 1 ? loadCorpus(argc, argv, 0) : FORMULA_PROGRAM;
+        LineIndex lines(source);
+        vector<Token> tokens = lexAll(*lexer, source);
+        Ast ast;
+        Parser(tokens, lines).parse(ast);
+
+        Evaluator evaluator(ast, lines);
+        Bytecode program = compileBytecode(ast, lines);
+        BytecodeVM vm;
+        vector<double> printed;
+#ifdef BYTECODE_SWITCH_DISPATCH
+        const char* dispatch = "switch";
+#else
+        const char* dispatch = "default";
+#endif
+        printf("%zu nodes, %zu instructions, %s dispatch\n", ast.size(), program.code.size(), dispatch);
+
+        const int runs = argc > 1 ? 100 : 200000;
+        double walkerNs = bestNanoseconds([&] {
+            for (int r = 0; r < runs; r++) evaluator.run(printed);
+        }) / runs;
+        double vmNs = bestNanoseconds([&] {
+            for (int r = 0; r < runs; r++) vm.run(program, printed);
+        }) / runs;
+        printf("tree walker  %9.1f ns/run  %5.2f ns/node\n", walkerNs, walkerNs / ast.size());
+        printf("bytecode VM  %9.1f ns/run  %5.2f ns/node\n", vmNs, vmNs / ast.size());
+    } catch (const std::exception& e) {
+        fprintf(stderr, "%s\n", e.what());
+        return 1;
+    }
+    return 0;
+}
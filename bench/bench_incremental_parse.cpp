@@ -0,0 +1,90 @@
+#include <algorithm>
+#include <cstdio>
+#include <exception>
+#include "bench_util.h"
+#include "incremental_parse.h"
+
+using namespace std;
+
+// Latency of a keystroke-sized edit plus the diagnostics query on a large
+// program, against a full Parser::parse(ast, diagnostics). Most edits swap
+// one token for another of the same length; every tenth types an opening
+// parenthesis, which the next edit deletes again, so the program goes
+// through broken states the way it does while someone types.
+//
+//   bench_incremental_parse [program-file]
+int main(int argc, char** argv) {
+    try {
+        shared_ptr<const CompiledLexer> lexer = buildLexer(defaultTokenRules());
+        string text = loadCorpus(argc, argv, 100000);
+        vector<Token> tokens = lexAll(*lexer, text);
+        vector<Token> paren = lexAll(*lexer, "(");
+        LineIndex lines(text);
+        printf("%zu tokens\n", tokens.size());
+
+        Ast ast;
+        vector<Diagnostic> diagnostics;
+        double fullNs = bestNanoseconds([&] { Parser(tokens, lines).parse(ast, diagnostics); }, 3);
+
+        IncrementalParser incremental;
+        incremental.load(tokens);
+        mt19937 rng(17);
+        const int edits = 2000;
+        vector<double> latencies;
+        size_t typedAt = 0;
+        for (int k = 0; k < edits; k++) {
+            size_t i = rng() % tokens.size();
+            double ns;
+            if (k % 10 == 0) {
+                typedAt = i;
+                vector<Token> inserted = paren;
+                inserted[0].offset = tokens[i].offset;
+                text.insert(tokens[i].offset, "( ");
+                lines = LineIndex(text);
+                ns = bestNanoseconds([&] {
+                    incremental.edit(i, 0, inserted, 2);
+                    incremental.diagnostics(lines, diagnostics);
+                }, 1);
+                for (size_t j = i; j < tokens.size(); j++) tokens[j].offset += 2;
+                tokens.insert(tokens.begin() + i, inserted[0]);
+            } else if (k % 10 == 1) {
+                i = typedAt;
+                text.erase(tokens[i].offset, 2);
+                lines = LineIndex(text);
+                ns = bestNanoseconds([&] {
+                    incremental.edit(i, 1, TokenSpan(), -2);
+                    incremental.diagnostics(lines, diagnostics);
+                }, 1);
+                tokens.erase(tokens.begin() + i);
+                for (size_t j = i; j < tokens.size(); j++) tokens[j].offset -= 2;
+            } else {
+                Token& t = tokens[i];
+                string lexeme;
+                if (t.type == IDENTIFIER) lexeme = string(t.value.size(), 'q');
+                else if (t.type == NUMBER) lexeme = string(t.value.size(), '7');
+                else if (t.type == PLUS || t.type == MINUS) lexeme = t.type == PLUS ? "-" : "+";
+                else if (t.type == MULTIPLY || t.type == DIVIDE) lexeme = t.type == MULTIPLY ? "/" : "*";
+                else continue;
+                vector<Token> inserted = lexAll(*lexer, lexeme);
+                inserted[0].offset = t.offset;
+                text.replace(t.offset, lexeme.size(), lexeme);
+                ns = bestNanoseconds([&] {
+                    incremental.edit(i, 1, inserted, 0);
+                    incremental.diagnostics(lines, diagnostics);
+                }, 1);
+                t = inserted[0];
+            }
+            latencies.push_back(ns);
+        }
+
+        sort(latencies.begin(), latencies.end());
+        printf("full parse         %8.1f us\n", fullNs / 1000);
+        printf("edit + diagnostics %8.1f us median  %8.1f us p99  %8.1f us max  (%zu edits)\n",
+               latencies[latencies.size() / 2] / 1000, latencies[latencies.size() * 99 / 100] / 1000,
+               latencies.back() / 1000, latencies.size());
+    } catch (const std::exception& e) {
+        fprintf(stderr, "%s\n", e.what());
+        return 1;
+    }
+    return 0;
+}
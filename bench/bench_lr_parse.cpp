@@ -0,0 +1,50 @@
+#include <cstdio>
+#include <exception>
+#include "bench_util.h"
+#include "lr_parse.h"
+#include "syntactic.h"
+#include "trace_sink.h"
+
+using namespace std;
+
+// Steps and time per token of the LALR(1) shift-reduce parser against the
+// LL(1) PDA, with and without the Pratt expression engine.
+//
+//   bench_lr_parse [program-file]
+int main(int argc, char** argv) {
+    try {
+        shared_ptr<const CompiledLexer> lexer = buildLexer(defaultTokenRules());
+        string source = loadCorpus(argc, argv, 300000);
+        vector<Token> tokens = lexAll(*lexer, source);
+        double n = static_cast<double>(tokens.size());
+        printf("%zu tokens\n", tokens.size());
+
+        Parser pda(tokens), pratt(tokens);
+        pratt.setExpressionEngine(ExpressionEngine::Pratt);
+        LRParser lr(tokens);
+
+        CountingTraceSink pdaSteps, lrSteps;
+        pda.parse(pdaSteps);
+        lr.parse(lrSteps);
+        printf("steps/token      PDA %.2f (expand %.2f, match %.2f)   LALR %.2f (shift %.2f, reduce %.2f)\n",
+               pdaSteps.steps() / n, pdaSteps.count(PDAOp::Expand) / n, pdaSteps.count(PDAOp::Match) / n,
+               lrSteps.steps() / n, lrSteps.count(PDAOp::Push) / n, lrSteps.count(PDAOp::Reduce) / n);
+
+        Ast ast;
+        printf("validate ns/token    PDA %6.1f   Pratt %6.1f   LALR %6.1f\n",
+               bestNanoseconds([&] { pda.validate(); }) / n,
+               bestNanoseconds([&] { pratt.validate(); }) / n,
+               bestNanoseconds([&] { lr.validate(); }) / n);
+        printf("parse(Ast) ns/token  PDA %6.1f   Pratt %6.1f   LALR %6.1f\n",
+               bestNanoseconds([&] { pda.parse(ast); }) / n,
+               bestNanoseconds([&] { pratt.parse(ast); }) / n,
+               bestNanoseconds([&] { lr.parse(ast); }) / n);
+        printf("traced ns/token      PDA %6.1f                  LALR %6.1f\n",
+               bestNanoseconds([&] { pda.parse(pdaSteps); }) / n,
+               bestNanoseconds([&] { lr.parse(lrSteps); }) / n);
+    } catch (const std::exception& e) {
+        fprintf(stderr, "%s\n", e.what());
+        return 1;
+    }
+    return 0;
+}
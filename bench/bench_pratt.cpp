@@ -0,0 +1,36 @@
+#include <cstdio>
+#include <exception>
+#include "bench_util.h"
+#include "syntactic.h"
+
+using namespace std;
+
+// Time per token of the Pratt expression engine against the PDA, for each
+// way of running Parser.
+//
+//   bench_pratt [program-file]
+int main(int argc, char** argv) {
+    try {
+        shared_ptr<const CompiledLexer> lexer = buildLexer(defaultTokenRules());
+        string source = loadCorpus(argc, argv, 500000);
+        vector<Token> tokens = lexAll(*lexer, source);
+        double n = static_cast<double>(tokens.size());
+        printf("%zu tokens\n", tokens.size());
+
+        for (ExpressionEngine engine : { ExpressionEngine::Pda, ExpressionEngine::Pratt }) {
+            Parser parser(tokens);
+            parser.setExpressionEngine(engine);
+            Ast ast;
+            vector<Diagnostic> diagnostics;
+            printf("%-5s  validate %5.1f  parse(Ast) %5.1f  recovering parse(Ast) %5.1f ns/token\n",
+                   engine == ExpressionEngine::Pda ? "PDA" : "Pratt",
+                   bestNanoseconds([&] { parser.validate(); }) / n,
+                   bestNanoseconds([&] { parser.parse(ast); }) / n,
+                   bestNanoseconds([&] { parser.parse(ast, diagnostics); }) / n);
+        }
+    } catch (const std::exception& e) {
+        fprintf(stderr, "%s\n", e.what());
+        return 1;
+    }
+    return 0;
+}
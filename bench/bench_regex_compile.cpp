@@ -0,0 +1,47 @@
+#include <cstdio>
+#include <cstdlib>
+#include <exception>
+#include "bench_util.h"
+#include "regex_nfa.h"
+
+using namespace std;
+
+// Startup cost of regex token rules: compiling hundreds of patterns to
+// Thompson NFAs, and building a whole lexer (NFA, DFA, table) from them.
+//
+//   bench_regex_compile [pattern-count]
+int main(int argc, char** argv) {
+    try {
+        size_t count = argc > 1 ? strtoul(argv[1], nullptr, 10) : 500;
+        vector<string> patterns;
+        for (size_t i = 0; i < count; i++) {
+            patterns.push_back("kw" + to_string(i) + "_[a-z0-9]*(\\.[0-9]+)?|x" + to_string(i) + "[A-F]+");
+        }
+
+        size_t states = 0;
+        double compileNs = bestNanoseconds([&] {
+            AutomatonArena arena;
+            for (const string& p : patterns) compileRegex(p, IDENTIFIER, arena);
+            states = arena.size();
+        });
+        printf("compileRegex: %zu patterns, %zu NFA states, %.2f ms (%.1f us/pattern)\n",
+               count, states, compileNs * 1e-6, compileNs * 1e-3 / count);
+
+        double defaultNs = bestNanoseconds([&] { buildLexer(defaultTokenRules()); });
+        printf("buildLexer, default rules: %.2f ms\n", defaultNs * 1e-6);
+
+        for (size_t n : { size_t(10), size_t(50), size_t(100) }) {
+            if (n > count) break;
+            TokenRules rules = defaultTokenRules();
+            for (size_t i = 0; i < n; i++) rules.patterns.push_back({ patterns[i], IDENTIFIER });
+            shared_ptr<const CompiledLexer> lexer;
+            double buildNs = bestNanoseconds([&] { lexer = buildLexer(rules); }, 3);
+            printf("buildLexer, default rules + %3zu patterns: %zu DFA states, %.2f ms\n",
+                   n, lexer->dfa.allStates.size(), buildNs * 1e-6);
+        }
+    } catch (const std::exception& e) {
+        fprintf(stderr, "%s\n", e.what());
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,37 @@
+#include <cstdio>
+#include <exception>
+#include "bench_util.h"
+#include "static_parse.h"
+#include "syntactic.h"
+
+using namespace std;
+
+// Time per token of the compile-time recursive-descent StaticParser
+// against the table-driven Parser.
+//
+//   bench_static_parse [program-file]
+int main(int argc, char** argv) {
+    try {
+        shared_ptr<const CompiledLexer> lexer = buildLexer(defaultTokenRules());
+        string source = loadCorpus(argc, argv, 300000);
+        vector<Token> tokens = lexAll(*lexer, source);
+        double n = static_cast<double>(tokens.size());
+        printf("%zu tokens\n", tokens.size());
+
+        Parser table(tokens);
+        StaticParser generated(tokens);
+        Ast ast;
+        double tableValidate = bestNanoseconds([&] { table.validate(); }) / n;
+        double generatedValidate = bestNanoseconds([&] { generated.validate(); }) / n;
+        double tableParse = bestNanoseconds([&] { table.parse(ast); }) / n;
+        double generatedParse = bestNanoseconds([&] { generated.parse(ast); }) / n;
+        printf("validate    Parser %5.1f  StaticParser %5.1f ns/token (%.1fx)\n",
+               tableValidate, generatedValidate, tableValidate / generatedValidate);
+        printf("parse(Ast)  Parser %5.1f  StaticParser %5.1f ns/token (%.1fx)\n",
+               tableParse, generatedParse, tableParse / generatedParse);
+    } catch (const std::exception& e) {
+        fprintf(stderr, "%s\n", e.what());
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,45 @@
+#include <cstdio>
+#include <exception>
+#include "bench_util.h"
+#include "syntactic.h"
+#include "token_pipeline.h"
+
+using namespace std;
+
+// End-to-end lex + validate throughput of the two-thread TokenPipeline
+// against the sequential paths: lexing into a vector first, and pulling
+// tokens from a TokenStream on the parser's thread.
+//
+//   bench_token_pipeline [program-file]
+int main(int argc, char** argv) {
+    try {
+        shared_ptr<const CompiledLexer> lexer = buildLexer(defaultTokenRules());
+        string source = loadCorpus(argc, argv, 1000000);
+        double megabytes = source.size() / 1048576.0;
+        printf("%.1f MB, %u hardware threads\n", megabytes, thread::hardware_concurrency());
+
+        double vectorNs = bestNanoseconds([&] {
+            vector<Token> tokens = lexAll(*lexer, source);
+            Parser(tokens).validate();
+        }, 3);
+        double streamNs = bestNanoseconds([&] {
+            TokenStream stream(*lexer, source);
+            Parser(stream).validate();
+        }, 3);
+        PipelineStats stats;
+        double pipelineNs = bestNanoseconds([&] {
+            TokenPipeline pipeline(lexer, source);
+            Parser(pipeline).validate();
+            stats = pipeline.stats();
+        }, 3);
+
+        printf("sequential, vector  %7.1f MB/s\n", megabytes / (vectorNs * 1e-9));
+        printf("sequential, stream  %7.1f MB/s\n", megabytes / (streamNs * 1e-9));
+        printf("pipeline            %7.1f MB/s  (%zu tokens in %zu batches, lexer stalls %zu, parser stalls %zu)\n",
+               megabytes / (pipelineNs * 1e-9), stats.tokens, stats.batches, stats.producerStalls, stats.consumerStalls);
+    } catch (const std::exception& e) {
+        fprintf(stderr, "%s\n", e.what());
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,48 @@
+#include <cstdio>
+#include <exception>
+#include "bench_util.h"
+#include "tokenize_service.h"
+
+using namespace std;
+
+// Batch throughput of TokenizeService in documents and bytes per second,
+// with 1 worker and with every hardware thread, against lexing the same
+// documents one after another with a TokenStream. The documents are the
+// lines of the corpus, i.e. formula-sized inputs.
+//
+//   bench_tokenize_service [program-file]
+int main(int argc, char** argv) {
+    try {
+        shared_ptr<const CompiledLexer> lexer = buildLexer(defaultTokenRules());
+        string source = loadCorpus(argc, argv, 200000);
+        vector<string> inputs;
+        istringstream lines(source);
+        for (string line; getline(lines, line); ) inputs.push_back(line);
+        double megabytes = source.size() / 1048576.0;
+        printf("%zu documents, %.1f MB, %u hardware threads\n", inputs.size(), megabytes, thread::hardware_concurrency());
+
+        double sequentialNs = bestNanoseconds([&] {
+            for (const string& doc : inputs) lexAll(*lexer, doc);
+        }, 3);
+        printf("sequential      %10.0f docs/s  %7.1f MB/s\n",
+               inputs.size() / (sequentialNs * 1e-9), megabytes / (sequentialNs * 1e-9));
+
+        unsigned most = max(1u, thread::hardware_concurrency());
+        for (unsigned threads : { 1u, most }) {
+            TokenizeService service(lexer, threads);
+            vector<DocumentTokens> results;
+            BatchStats best;
+            for (int run = 0; run < 3; run++) {
+                BatchStats stats = service.tokenizeBatch(inputs, results);
+                if (run == 0 || stats.seconds < best.seconds) best = stats;
+            }
+            printf("service, %2u    %10.0f docs/s  %7.1f MB/s  (%zu tokens)\n",
+                   threads, best.documentsPerSecond(), best.bytesPerSecond() / 1048576.0, best.tokens);
+            if (threads == most) break;
+        }
+    } catch (const std::exception& e) {
+        fprintf(stderr, "%s\n", e.what());
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,172 @@
+#ifndef BENCH_UTIL_H
+#define BENCH_UTIL_H
+
+#include <chrono>
+#include <fstream>
+#include <iterator>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "ast.h"
+#include "lexical.h"
+#include "syntactic.h"
+
+using namespace std;
+
+// Helpers shared by the benchmark and check drivers; inline so that each
+// driver stays a single source file.
+
+// Statement shapes the generated corpus is drawn from
+static const char* const CORPUS_STATEMENTS[] = {
+    "x = (a + b) * sin(c - 3) % 7\n",
+    "print(x / 2)\n",
+    "y = 1 - 2 - 3\n",
+    "z = a * b + c * d - e / f + g % h * (i - j)\n",
+    "total = total + price * 3\n",
+    "r = sqrt(x * x + y * y)\n"
+};
+
+// The program in argv[1] if there is one, else `statements` statements
+// drawn from CORPUS_STATEMENTS with a fixed seed, so runs are comparable
+inline string loadCorpus(int argc, char** argv, size_t statements) {
+    if (argc > 1) {
+        ifstream in(argv[1], ios::binary);
+        if (!in) throw std::runtime_error(string("Cannot open corpus ") + argv[1]);
+        ostringstream buffer;
+        buffer << in.rdbuf();
+        return buffer.str();
+    }
+    mt19937 rng(3);
+    string source;
+    for (size_t i = 0; i < statements; i++) source += CORPUS_STATEMENTS[rng() % size(CORPUS_STATEMENTS)];
+    return source;
+}
+
+
+inline vector<Token> lexAll(const CompiledLexer& lexer, const string& source) {
+    TokenStream stream(lexer, source);
+    vector<Token> tokens;
+    Token token(UNKNOWN, "", 0);
+    while (stream.next(token)) tokens.push_back(token);
+    return tokens;
+}
+
+
+// Fastest of `runs` timings of f, in nanoseconds
+template <typename F>
+double bestNanoseconds(F f, int runs = 5) {
+    double best = 0;
+    for (int r = 0; r < runs; r++) {
+        auto start = chrono::steady_clock::now();
+        f();
+        double elapsed = chrono::duration<double, nano>(chrono::steady_clock::now() - start).count();
+        if (r == 0 || elapsed < best) best = elapsed;
+    }
+    return best;
+}
+
+
+// A short program that is mostly valid: a few assignments and prints of
+// random terms, then, if `edit`, up to two random insertions or deletions
+// that usually make it invalid somewhere
+inline string randomProgram(mt19937& rng, bool edit) {
+    static const char* const fragments[] = {
+        "a", "b", "7", "2.5", "sin(", "cos(", "(", ")", "+", "-", "*", "/", "%",
+        "x = ", "print(", "\n", "=", "$", "@", "y"
+    };
+    string source;
+    int statements = static_cast<int>(rng() % 60) / 6 + 1;
+    for (int i = 0; i < statements; i++) {
+        bool print = rng() % 2 == 0;
+        source += print ? "print(" : "x = ";
+        int depth = 0;
+        int terms = static_cast<int>(rng() % 5) + 1;
+        for (int k = 0; k < terms; k++) {
+            if (k) source += string(" ") + "+-*/%"[rng() % 5] + " ";
+            int opener = static_cast<int>(rng() % 5);
+            if (opener == 0) { source += "sin("; depth++; }
+            else if (opener == 1) { source += "("; depth++; }
+            source += rng() % 2 ? "a" : "3";
+            if (depth && rng() % 2) { source += ")"; depth--; }
+        }
+        while (depth--) source += ")";
+        if (print) source += ")";
+        source += "\n";
+    }
+    int edits = edit ? static_cast<int>(rng() % 3) : 0;
+    for (int e = 0; e < edits && !source.empty(); e++) {
+        size_t at = rng() % source.size();
+        if (rng() % 2) source.insert(at, fragments[rng() % size(fragments)]);
+        else source.erase(at, 1);
+    }
+    return source;
+}
+
+
+// Every node field, and the value of every number, so that two parses
+// compare equal only if they built the very same tree. Flat rather than
+// Ast::toString, which recurses and would overflow on very deep trees.
+inline string describeAst(const Ast& ast) {
+    string out;
+    for (size_t i = 0; i < ast.size(); i++) {
+        const AstNode& n = ast[static_cast<NodeIndex>(i)];
+        out += to_string(static_cast<int>(n.kind)) + "," + to_string(static_cast<int>(n.op)) + "," +
+               to_string(n.token) + "," + to_string(n.left) + "," + to_string(n.right);
+        if (n.kind == AstKind::Number) out += "=" + to_string(ast.number(n));
+        out += ";";
+    }
+    return out;
+}
+
+
+// The statements in order, each in prefix form with every node's kind,
+// operator, token and number value, but not where the nodes sit. Unlike
+// describeAst this reads only reachable nodes, so it also fits trees whose
+// slots have gaps, as ParallelParser's joined trees do. tokenBase is added
+// to token indices, for trees built over part of a program. Iterative, for
+// the same reason as describeAst.
+inline string describeTree(const Ast& ast, size_t tokenBase = 0) {
+    string out;
+    vector<NodeIndex> pending;
+    for (NodeIndex s = ast.firstStatement(); s != NO_NODE; s = ast[s].right) {
+        pending.assign(1, s);
+        while (!pending.empty()) {
+            const AstNode& n = ast[pending.back()];
+            pending.pop_back();
+            out += to_string(static_cast<int>(n.kind)) + "," + to_string(static_cast<int>(n.op)) + "," +
+                   to_string(tokenBase + n.token);
+            if (n.kind == AstKind::Number) out += "=" + to_string(ast.number(n));
+            out += " ";
+            if (n.kind == AstKind::Binary) pending.push_back(n.right);
+            if (n.kind != AstKind::Number && n.kind != AstKind::Variable) pending.push_back(n.left);
+        }
+        out += ";";
+    }
+    return out;
+}
+
+
+inline string describeDiagnostics(const vector<Diagnostic>& diagnostics) {
+    string out;
+    for (const Diagnostic& d : diagnostics) {
+        out += to_string(d.tokenIndex) + "/" + to_string(d.offset) + "@" + to_string(d.line) + ":" +
+               to_string(d.column) + " " + d.message + "\n";
+    }
+    return out;
+}
+
+
+// "ok", or the message f threw
+template <typename F>
+string outcome(F f) {
+    try {
+        f();
+        return "ok";
+    } catch (const std::exception& e) {
+        return e.what();
+    }
+}
+
+#endif
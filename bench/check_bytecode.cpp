@@ -0,0 +1,139 @@
+#include <cstdio>
+#include "bench_util.h"
+#include "bytecode.h"
+#include "evaluator.h"
+
+using namespace std;
+
+// Statements over a few variables, most but not all of them given a value
+// up front, with every operator and builtin, operands of both signs and
+// the odd zero to divide by
+static string randomCalculation(mt19937& rng) {
+    static const char* const names[] = { "a", "b", "x", "total" };
+    static const char* const functions[] = { "sin", "cos", "tan", "sqrt", "abs", "ceil", "floor" };
+    static const char* const numbers[] = { "1", "2.5", "3", "7", "(0 - 7)", "(0 - 2.5)", "0.1", "(3 - 2)" };
+    string source;
+    for (const char* name : names) {
+        if (rng() % 8 != 0) source += string(name) + " = " + numbers[rng() % size(numbers)] + "\n";
+    }
+    int statements = static_cast<int>(rng() % 8) + 1;
+    for (int s = 0; s < statements; s++) {
+        bool print = rng() % 3 == 0;
+        source += print ? "print(" : string(names[rng() % size(names)]) + " = ";
+        int depth = 0;
+        int terms = static_cast<int>(rng() % 6) + 1;
+        for (int k = 0; k < terms; k++) {
+            if (k) source += string(" ") + "+-*/%"[rng() % 5] + " ";
+            int opener = static_cast<int>(rng() % 6);
+            if (opener == 0) { source += string(functions[rng() % size(functions)]) + "("; depth++; }
+            else if (opener == 1) { source += "("; depth++; }
+            if (rng() % 40 == 0) source += "0";
+            else source += rng() % 3 == 0 ? names[rng() % size(names)] : numbers[rng() % size(numbers)];
+            if (depth && rng() % 2) { source += ")"; depth--; }
+        }
+        while (depth--) source += ")";
+        if (print) source += ")";
+        source += "\n";
+    }
+    return source;
+}
+
+
+// Bit for bit, so that nan and -0 compare too
+static string describeValues(const vector<double>& values) {
+    string out;
+    char buffer[40];
+    for (double v : values) {
+        snprintf(buffer, sizeof buffer, "%a ", v);
+        out += buffer;
+    }
+    return out;
+}
+
+
+// What running the program did: the error or "ok", what it printed up to
+// there, and every variable's value by name
+static string runEvaluator(const Ast& ast, const LineIndex& lines) {
+    vector<double> printed;
+    unique_ptr<Evaluator> evaluator;
+    string result = outcome([&] {
+        evaluator = make_unique<Evaluator>(ast, lines);
+        evaluator->run(printed);
+    });
+    result += "\nprinted " + describeValues(printed);
+    for (size_t slot = 0; evaluator && slot < evaluator->variableCount(); slot++) {
+        result += "\n" + evaluator->variableName(slot) + " " + describeValues({ evaluator->variableValue(slot) });
+    }
+    return result;
+}
+
+
+static string runBytecode(const Ast& ast, const LineIndex& lines) {
+    vector<double> printed;
+    Bytecode program;
+    BytecodeVM vm;
+    bool compiled = false;
+    string result = outcome([&] {
+        program = compileBytecode(ast, lines);
+        compiled = true;
+        vm.run(program, printed);
+    });
+    result += "\nprinted " + describeValues(printed);
+    for (size_t slot = 0; compiled && slot < program.variableNames.size(); slot++) {
+        result += "\n" + program.variableNames[slot] + " " + describeValues({ vm.variableValue(slot) });
+    }
+    return result;
+}
+
+
+// Differential check of BytecodeVM against the tree-walking Evaluator: on
+// random straight-line programs, both must print the same values, leave
+// every variable with the same value and throw the same runtime errors,
+// with the same text. Also checks % against Python's result for every sign
+// combination. The driver is built once per dispatch variant. Exits
+// non-zero on any difference.
+int main() {
+#ifdef BYTECODE_SWITCH_DISPATCH
+    printf("switch dispatch\n");
+#else
+    printf("default dispatch\n");
+#endif
+    shared_ptr<const CompiledLexer> lexer = buildLexer(defaultTokenRules());
+    int mismatches = 0;
+    auto compare = [&](const string& source, const string& expectedPrints) {
+        LineIndex lines(source);
+        vector<Token> tokens = lexAll(*lexer, source);
+        Ast ast;
+        Parser(tokens, lines).parse(ast);
+        string expected = runEvaluator(ast, lines);
+        string actual = runBytecode(ast, lines);
+        bool printsRight = expectedPrints.empty() ||
+                           expected.compare(0, expectedPrints.size() + 11, "ok\nprinted " + expectedPrints) == 0;
+        if ((expected != actual || !printsRight) && mismatches++ < 3) {
+            printf("differs on:\n%s\nEvaluator:  %s\nBytecodeVM: %s\n", source.c_str(), expected.c_str(), actual.c_str());
+        }
+        return expected.compare(0, 2, "ok") != 0;
+    };
+
+    // Python: 7 % 3, -7 % 3, 7 % -3, -7 % -3, 7.5 % 2, -7.5 % 2, 0 % -3
+    compare("print(7 % 3)\nprint((0 - 7) % 3)\nprint(7 % (0 - 3))\nprint((0 - 7) % (0 - 3))\n"
+            "print(7.5 % 2)\nprint((0 - 7.5) % 2)\nprint(0 % (0 - 3))\n",
+            describeValues({ 1, 2, -2, -1, 1.5, 0.5, 0 }));
+    string deep = "x = " + string(100000, '(') + "1" + string(100000, ')') + "\nprint(x)\n";
+    LineIndex deepLines(deep);
+    vector<Token> deepTokens = lexAll(*lexer, deep);
+    Ast deepAst;
+    Parser(deepTokens, deepLines).parse(deepAst);
+    string deepResult = runBytecode(deepAst, deepLines);
+    if (deepResult.compare(0, 2, "ok") != 0 && mismatches++ < 3) printf("deep expression: %s\n", deepResult.c_str());
+
+    mt19937 rng(50);
+    const int programs = 30000;
+    int failing = 0;
+    for (int trial = 0; trial < programs; trial++) {
+        if (compare(randomCalculation(rng), "")) failing++;
+    }
+    printf("%d programs (%d with runtime errors) plus %% signs and a deep expression, %d mismatches\n",
+           programs, failing, mismatches);
+    return mismatches == 0 ? 0 : 1;
+}
@@ -0,0 +1,85 @@
+#include <cstdio>
+#include "bench_util.h"
+#include "incremental_parse.h"
+
+using namespace std;
+
+// Differential check of IncrementalParser against a full reparse: random
+// token edits on generated programs, most of them left broken, plus
+// programs that only get whole statements inserted and stay valid. After
+// every edit the entries' trees and the diagnostics must be those of
+// Parser::parse(ast, diagnostics) over the whole edited program. Exits
+// non-zero on any difference.
+int main() {
+    shared_ptr<const CompiledLexer> lexer = buildLexer(defaultTokenRules());
+    static const char* const fragments[] = {
+        "", "x = 1", "print(", ")", "(", "+", "*", "a", "7", "\n", "=", "$", "@",
+        "y = sin(a)\n", "print(b)\n", "x = ", "z = 2 % (a"
+    };
+    static const char* const statements[] = { "y = sin(a)\n", "print(b)\n", "x = 1\n", "q = (a + 2) * b\n" };
+    mt19937 rng(43);
+    const int programs = 200, editsPerProgram = 60;
+    int mismatches = 0, broken = 0;
+    auto report = [&](const string& what) {
+        if (mismatches++ < 3) printf("%s\n", what.c_str());
+    };
+
+    for (int p = 0; p < programs; p++) {
+        bool staysValid = p % 3 == 0;
+        string text;
+        size_t pieces = rng() % 60 + 1;
+        for (size_t i = 0; i < pieces; i++) text += randomProgram(rng, !staysValid && rng() % 10 == 0);
+        vector<Token> tokens = lexAll(*lexer, text);
+        IncrementalParser incremental;
+        incremental.load(tokens);
+
+        for (int e = 0; e < editsPerProgram; e++) {
+            // Replace a few tokens; the spaces keep the new tokens from
+            // running into their neighbours, so lexing the new text alone
+            // gives what lexing the whole edited program would
+            size_t first = rng() % (tokens.size() + 1);
+            size_t removed = min<size_t>(rng() % 4, tokens.size() - first);
+            const char* fragment = fragments[rng() % size(fragments)];
+            if (staysValid) {
+                while (first < tokens.size() && tokens[first].type != PRINT &&
+                       !(tokens[first].type == IDENTIFIER && first + 1 < tokens.size() && tokens[first + 1].type == ASSIGN)) {
+                    first++;
+                }
+                removed = 0;
+                fragment = statements[rng() % size(statements)];
+            }
+            size_t from = first < tokens.size() ? tokens[first].offset : text.size();
+            size_t to = first + removed < tokens.size() ? tokens[first + removed].offset : text.size();
+            string inserted = string(" ") + fragment + " ";
+
+            vector<Token> insertedTokens = lexAll(*lexer, inserted);
+            for (Token& t : insertedTokens) t.offset += from;
+            ptrdiff_t textShift = static_cast<ptrdiff_t>(inserted.size()) - static_cast<ptrdiff_t>(to - from);
+            text.replace(from, to - from, inserted);
+            incremental.edit(first, removed, insertedTokens, textShift);
+            tokens = lexAll(*lexer, text);
+
+            LineIndex lines(text);
+            Ast full;
+            vector<Diagnostic> expected, actual;
+            Parser(tokens, lines).parse(full, expected);
+            incremental.diagnostics(lines, actual);
+            if (!expected.empty()) broken++;
+
+            string tree;
+            for (size_t i = 0; i < incremental.statementCount(); i++) {
+                tree += describeTree(incremental.statementTree(i), incremental.statementStart(i));
+            }
+            if (incremental.tokenCount() != tokens.size()) {
+                report("token count " + to_string(incremental.tokenCount()) + " vs " + to_string(tokens.size()));
+            } else if (tree != describeTree(full)) {
+                report("trees differ after edit " + to_string(e) + " of program " + to_string(p));
+            } else if (describeDiagnostics(actual) != describeDiagnostics(expected) ||
+                       incremental.errorCount() != expected.size()) {
+                report("diagnostics differ after edit " + to_string(e) + " of program " + to_string(p));
+            }
+        }
+    }
+    printf("%d edits (%d leaving errors), %d mismatches\n", programs * editsPerProgram, broken, mismatches);
+    return mismatches == 0 ? 0 : 1;
+}
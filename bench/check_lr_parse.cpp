@@ -0,0 +1,49 @@
+#include <cstdio>
+#include "bench_util.h"
+#include "lr_parse.h"
+#include "syntactic.h"
+
+using namespace std;
+
+// Differential check of the LALR(1) LRParser against the LL(1) Parser: on
+// random programs, valid and not, and on deeply nested and very long
+// inputs, both must accept and reject alike, throw the same first error
+// and build the same trees node for node. Exits non-zero on any difference.
+int main() {
+    shared_ptr<const CompiledLexer> lexer = buildLexer(defaultTokenRules());
+    int mismatches = 0;
+    auto compare = [&](const string& source) {
+        LineIndex lines(source);
+        vector<Token> tokens = lexAll(*lexer, source);
+        Parser pda(tokens, lines);
+        LRParser lr(tokens, lines);
+        string expected = outcome([&] { pda.validate(); });
+        string actual = outcome([&] { lr.validate(); });
+        Ast a1, a2;
+        string built1 = outcome([&] { pda.parse(a1); });
+        string built2 = outcome([&] { lr.parse(a2); });
+        expected += "\n" + built1 + (built1 == "ok" ? describeAst(a1) : "");
+        actual += "\n" + built2 + (built2 == "ok" ? describeAst(a2) : "");
+        if (expected != actual && mismatches++ < 3) {
+            printf("differs on:\n%.300s\nParser:   %.300s\nLRParser: %.300s\n",
+                   source.c_str(), expected.c_str(), actual.c_str());
+        }
+        return expected.compare(0, 2, "ok") != 0;
+    };
+
+    compare("x = " + string(100000, '(') + "1" + string(100000, ')') + "\nprint(x)\n");
+    string longProgram = "x = 1";
+    for (int i = 0; i < 200000; i++) longProgram += " - a * 2 / b";
+    longProgram += "\n";
+    for (int i = 0; i < 200000; i++) longProgram += "y = 2\n";
+    compare(longProgram);
+
+    mt19937 rng(47);
+    const int programs = 30000;
+    int rejected = 0;
+    for (int trial = 0; trial < programs; trial++) {
+        if (compare(randomProgram(rng, trial % 3 != 0))) rejected++;
+    }
+    printf("%d programs (%d rejected) plus deep and long inputs, %d mismatches\n", programs, rejected, mismatches);
+    return mismatches == 0 ? 0 : 1;
+}
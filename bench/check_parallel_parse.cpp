@@ -0,0 +1,57 @@
+#include <cstdio>
+#include "bench_util.h"
+#include "parallel_parse.h"
+
+using namespace std;
+
+// Differential check of ParallelParser against one Parser over the whole
+// buffer: on programs large enough to be split, with random junk inserted
+// (including in-band "$", which ends the serial parse early), both must
+// build identical trees and report identical diagnostics, on 2 to 4
+// workers. Exits non-zero on any difference.
+int main() {
+    shared_ptr<const CompiledLexer> lexer = buildLexer(defaultTokenRules());
+    static const char* const junk[] = { "$", "@", "(", ")", "=", "print", "x = ", "\n", "+", "$\n" };
+    vector<unique_ptr<ParallelParser>> pools;
+    for (unsigned threads = 2; threads <= 4; threads++) pools.push_back(make_unique<ParallelParser>(threads));
+    int mismatches = 0, inputs = 0, split = 0;
+
+    auto compare = [&](const string& source) {
+        LineIndex lines(source);
+        vector<Token> tokens = lexAll(*lexer, source);
+        Ast serialAst;
+        vector<Diagnostic> serialDiagnostics;
+        Parser(tokens, lines).parse(serialAst, serialDiagnostics);
+        string expected = describeTree(serialAst) + describeDiagnostics(serialDiagnostics);
+
+        for (auto& pool : pools) {
+            Ast ast;
+            vector<Diagnostic> diagnostics;
+            ParallelParseStats stats = pool->parse(tokens, lines, ast, diagnostics);
+            if (stats.chunks > 1) split++;
+            string actual = describeTree(ast) + describeDiagnostics(diagnostics);
+            if (actual != expected && mismatches++ < 3) {
+                printf("%zu workers differ on input %d: %zu vs %zu diagnostics\n", pool->threadCount(), inputs,
+                       diagnostics.size(), serialDiagnostics.size());
+            }
+        }
+        inputs++;
+    };
+
+    string dollarInside;
+    for (int i = 0; i < 5000; i++) dollarInside += "x = 1\n";
+    dollarInside += "$\n";
+    for (int i = 0; i < 5000; i++) dollarInside += "print(@)\n";
+    compare(dollarInside);
+
+    mt19937 rng(42);
+    for (int trial = 0; trial < 150; trial++) {
+        string source;
+        while (source.size() < 150000) source += randomProgram(rng, rng() % 200 == 0);
+        int edits = trial % 3 == 0 ? 0 : static_cast<int>(rng() % 8);
+        for (int e = 0; e < edits; e++) source.insert(rng() % source.size(), junk[rng() % size(junk)]);
+        compare(source);
+    }
+    printf("%d inputs (%d parallel parses split), %d mismatches\n", inputs, split, mismatches);
+    return mismatches == 0 ? 0 : 1;
+}
@@ -0,0 +1,61 @@
+#include <cstdio>
+#include "bench_util.h"
+#include "syntactic.h"
+
+using namespace std;
+
+// Differential check of the Pratt expression engine against the PDA: on
+// random programs, valid and not, both must accept and reject alike, build
+// identical trees and report identical errors and diagnostics, from a token
+// span and from a token stream. Exits non-zero on any difference.
+int main() {
+    shared_ptr<const CompiledLexer> lexer = buildLexer(defaultTokenRules());
+    mt19937 rng(21);
+    const int programs = 20000;
+    int mismatches = 0, withErrors = 0;
+
+    for (int trial = 0; trial < programs; trial++) {
+        string source = randomProgram(rng, trial % 3 != 0);
+        LineIndex lines(source);
+        vector<Token> tokens = lexAll(*lexer, source);
+
+        for (int mode = 0; mode < 4; mode++) {
+            Parser pda(tokens, lines), pratt(tokens, lines);
+            pratt.setExpressionEngine(ExpressionEngine::Pratt);
+            string expected, actual;
+            if (mode == 0) {
+                expected = outcome([&] { pda.validate(); });
+                actual = outcome([&] { pratt.validate(); });
+            } else if (mode == 1) {
+                Ast a1, a2;
+                expected = outcome([&] { pda.parse(a1); });
+                actual = outcome([&] { pratt.parse(a2); });
+                if (expected == "ok") expected += describeAst(a1);
+                if (actual == "ok") actual += describeAst(a2);
+            } else if (mode == 2) {
+                Ast a1, a2;
+                vector<Diagnostic> d1, d2;
+                pda.parse(a1, d1);
+                pratt.parse(a2, d2);
+                expected = describeAst(a1) + describeDiagnostics(d1) + to_string(pda.errorAtEndOfInput());
+                actual = describeAst(a2) + describeDiagnostics(d2) + to_string(pratt.errorAtEndOfInput());
+                if (!d1.empty()) withErrors++;
+            } else {
+                TokenStream s1(*lexer, source), s2(*lexer, source);
+                Parser q1(s1, lines), q2(s2, lines);
+                q2.setExpressionEngine(ExpressionEngine::Pratt);
+                vector<Diagnostic> d1, d2;
+                q1.validate(d1);
+                q2.validate(d2);
+                expected = describeDiagnostics(d1) + outcome([&] { q1.validate(); });
+                actual = describeDiagnostics(d2) + outcome([&] { q2.validate(); });
+            }
+            if (expected != actual && mismatches++ < 3) {
+                printf("mode %d differs on:\n%s\nPDA:   %.300s\nPratt: %.300s\n",
+                       mode, source.c_str(), expected.c_str(), actual.c_str());
+            }
+        }
+    }
+    printf("%d programs (%d with syntax errors), %d mismatches\n", programs, withErrors, mismatches);
+    return mismatches == 0 ? 0 : 1;
+}
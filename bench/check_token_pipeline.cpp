@@ -0,0 +1,55 @@
+#include <cstdio>
+#include "bench_util.h"
+#include "syntactic.h"
+#include "token_pipeline.h"
+
+using namespace std;
+
+// Differential check of the two-thread TokenPipeline against lexing up
+// front: on generated programs with random junk inserted, a Parser reading
+// from the pipeline must see every token, report the same diagnostics and
+// throw the same first error, also when it gives up halfway and the
+// pipeline is torn down under a running lexer. Exits non-zero on any
+// difference.
+int main() {
+    shared_ptr<const CompiledLexer> lexer = buildLexer(defaultTokenRules());
+    static const char* const junk[] = { "+", "(", ")", "=", "print", "q", "7", "@", "*", "#" };
+    mt19937 rng(9);
+    const int programs = 300;
+    int mismatches = 0;
+    auto report = [&](const string& what) {
+        if (mismatches++ < 3) printf("%s\n", what.c_str());
+    };
+
+    for (int trial = 0; trial < programs; trial++) {
+        size_t statements = rng() % (trial % 10 == 0 ? 5000 : 200);
+        string source;
+        for (size_t i = 0; i < statements; i++) source += CORPUS_STATEMENTS[rng() % 3];
+        int edits = trial % 4 == 0 ? 0 : static_cast<int>(rng() % 6);
+        for (int e = 0; e < edits && !source.empty(); e++) source.insert(rng() % source.size(), junk[rng() % size(junk)]);
+
+        LineIndex lines(source);
+        vector<Token> tokens = lexAll(*lexer, source);
+        vector<Diagnostic> expected, actual;
+        Parser(tokens, lines).validate(expected);
+        {
+            TokenPipeline pipeline(lexer, source);
+            Parser parser(pipeline, lines);
+            parser.validate(actual);
+            if (pipeline.stats().tokens != tokens.size()) {
+                report("token count " + to_string(pipeline.stats().tokens) + " vs " + to_string(tokens.size()));
+            }
+            // The pipeline is read once; a second pass must be refused
+            vector<Diagnostic> again;
+            if (!tokens.empty() && outcome([&] { parser.validate(again); }) == "ok") report("second pass not refused");
+        }
+        if (describeDiagnostics(expected) != describeDiagnostics(actual)) report("diagnostics differ on trial " + to_string(trial));
+
+        string firstError = outcome([&] { Parser(tokens, lines).validate(); });
+        TokenPipeline pipeline(lexer, source);
+        string pipelineError = outcome([&] { Parser(pipeline, lines).validate(); });
+        if (firstError != pipelineError) report(firstError + " | " + pipelineError);
+    }
+    printf("%d programs, %d mismatches\n", programs, mismatches);
+    return mismatches == 0 ? 0 : 1;
+}
@@ -0,0 +1,64 @@
+#include <cstdio>
+#include "bench_util.h"
+#include "tokenize_service.h"
+
+using namespace std;
+
+static bool sameTokens(DocumentTokens actual, const vector<Token>& expected) {
+    if (actual.size() != expected.size()) return false;
+    for (size_t i = 0; i < expected.size(); i++) {
+        const Token& a = actual[i];
+        const Token& e = expected[i];
+        if (a.type != e.type || a.value != e.value || a.lexeme != e.lexeme || a.offset != e.offset) return false;
+    }
+    return true;
+}
+
+
+// Differential check of TokenizeService::tokenizeBatch against lexing each
+// document on its own with a TokenStream: every document must get the same
+// tokens, at the same offsets, whatever worker ran it. Batches mix empty
+// documents, documents of a few thousand statements, and documents ending in
+// bytes no rule matches; each service runs several batches, so reused
+// output buffers are covered too. Exits non-zero on any difference.
+int main() {
+    shared_ptr<const CompiledLexer> lexer = buildLexer(defaultTokenRules());
+    static const char* const junk[] = { "@", "#", "$", "\x80", "?", "~", " @", "!\n" };
+    mt19937 rng(12);
+    int batches = 0, mismatches = 0;
+    auto report = [&](const string& what) {
+        if (mismatches++ < 3) printf("%s\n", what.c_str());
+    };
+
+    for (unsigned threads = 1; threads <= 4; threads++) {
+        TokenizeService service(lexer, threads);
+        for (int round = 0; round < 10; round++, batches++) {
+            vector<string> inputs(rng() % 200);
+            size_t bytes = 0;
+            for (string& doc : inputs) {
+                size_t statements = rng() % 20 == 0 ? 2000 : rng() % 8;
+                for (size_t i = 0; i < statements; i++) doc += CORPUS_STATEMENTS[rng() % size(CORPUS_STATEMENTS)];
+                int edits = static_cast<int>(rng() % 4);
+                for (int e = 0; e < edits; e++) doc.insert(rng() % (doc.size() + 1), junk[rng() % size(junk)]);
+                if (rng() % 3 == 0) doc += junk[rng() % size(junk)];
+                bytes += doc.size();
+            }
+
+            vector<DocumentTokens> results;
+            BatchStats stats = service.tokenizeBatch(inputs, results);
+            size_t tokens = 0;
+            for (size_t doc = 0; doc < inputs.size(); doc++) {
+                vector<Token> expected = lexAll(*lexer, inputs[doc]);
+                tokens += expected.size();
+                if (!sameTokens(results[doc], expected)) {
+                    report("document " + to_string(doc) + " of batch " + to_string(batches) + " differs");
+                }
+            }
+            if (stats.documents != inputs.size() || stats.bytes != bytes || stats.tokens != tokens) {
+                report("stats of batch " + to_string(batches) + " are off");
+            }
+        }
+    }
+    printf("%d batches, %d mismatches\n", batches, mismatches);
+    return mismatches == 0 ? 0 : 1;
+}
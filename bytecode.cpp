@@ -0,0 +1,267 @@
+#include <algorithm>
+#include <cstring>
+#include <sstream>
+#include <stdexcept>
+#include <unordered_map>
+#include <utility>
+#include "bytecode.h"
+
+using namespace std;
+
+#if (defined(__GNUC__) || defined(__clang__)) && !defined(BYTECODE_SWITCH_DISPATCH)
+#define BYTECODE_COMPUTED_GOTO 1
+#endif
+
+static const char* const OPCODE_NAMES[] = {
+    "Const", "Load", "Store", "Add", "Sub", "Mul", "Div", "Mod", "Call", "Print", "Fail", "Halt"
+};
+
+
+// Emits code in the order the Evaluator evaluates: operands left to right,
+// then their operator, so runtime errors come in the same order too
+class BytecodeCompiler {
+public:
+    BytecodeCompiler(const Ast& tree, Bytecode& out) : ast(tree), program(out) {}
+
+    void compile() {
+        for (NodeIndex s = ast.firstStatement(); s != NO_NODE; s = ast[s].right) {
+            const AstNode& statement = ast[s];
+            expression(statement.left);
+            if (statement.kind == AstKind::Assign) {
+                uint32_t slot = slotFor(ast.name(statement));
+                assigned[slot] = 1;
+                emit(OpCode::Store, slot, statement, -1);
+            } else {
+                emit(OpCode::Print, 0, statement, -1);
+            }
+        }
+        program.code.push_back(encodeInstruction(OpCode::Halt));
+        program.offsets.push_back(0);
+    }
+
+private:
+    const Ast& ast;
+    Bytecode& program;
+
+    unordered_map<string, uint32_t> slotOf;
+    vector<uint8_t> assigned;               // per slot: by an earlier statement
+    unordered_map<uint64_t, uint32_t> constantOf;   // by bit pattern
+    vector<pair<NodeIndex, bool>> pending;  // node, operands already emitted
+    size_t depth = 0;
+
+    void expression(NodeIndex root) {
+        pending.assign(1, {root, false});
+        while (!pending.empty()) {
+            auto [i, expanded] = pending.back();
+            pending.pop_back();
+            const AstNode& n = ast[i];
+
+            switch (n.kind) {
+                case AstKind::Number:
+                    emit(OpCode::Const, constantFor(ast.number(n)), n, 1);
+                    break;
+                case AstKind::Variable: {
+                    uint32_t slot = slotFor(ast.name(n));
+                    if (assigned[slot]) {
+                        emit(OpCode::Load, slot, n, 1);
+                    } else {
+                        string message = "Variable '" + ast.name(n) + "' is not defined";
+                        emit(OpCode::Fail, failureFor(runtimeErrorMessage(message, ast.token(n).offset, program.lines)), n, 1);
+                    }
+                    break;
+                }
+                case AstKind::Call: {
+                    Builtin builtin;
+                    if (!builtinNamed(ast.name(n), builtin)) {
+                        throw std::runtime_error(runtimeErrorMessage("Unknown function '" + ast.name(n) + "'",
+                                                                     ast.token(n).offset, program.lines));
+                    }
+                    if (expanded) {
+                        emit(OpCode::Call, static_cast<uint32_t>(builtin), n, 0);
+                    } else {
+                        pending.push_back({i, true});
+                        pending.push_back({n.left, false});
+                    }
+                    break;
+                }
+                case AstKind::Binary:
+                    if (expanded) {
+                        emit(binaryOp(n), 0, n, -1);
+                    } else {
+                        pending.push_back({i, true});
+                        pending.push_back({n.right, false});
+                        pending.push_back({n.left, false});
+                    }
+                    break;
+                default:
+                    throw std::runtime_error(runtimeErrorMessage("Cannot evaluate this node", ast.token(n).offset, program.lines));
+            }
+        }
+    }
+
+    OpCode binaryOp(const AstNode& n) const {
+        switch (n.op) {
+            case '+': return OpCode::Add;
+            case '-': return OpCode::Sub;
+            case '*': return OpCode::Mul;
+            case '/': return OpCode::Div;
+            case '%': return OpCode::Mod;
+        }
+        throw std::runtime_error(runtimeErrorMessage("Cannot evaluate this node", ast.token(n).offset, program.lines));
+    }
+
+    // stackEffect is what the instruction does to the depth of the value stack
+    void emit(OpCode op, uint32_t operand, const AstNode& at, int stackEffect) {
+        program.code.push_back(encodeInstruction(op, operand));
+        program.offsets.push_back(ast.token(at).offset);
+        depth += stackEffect;
+        program.maxStack = max(program.maxStack, depth);
+    }
+
+    uint32_t slotFor(const string& name) {
+        auto found = slotOf.emplace(name, static_cast<uint32_t>(program.variableNames.size()));
+        if (found.second) {
+            checkOperand(program.variableNames.size(), "variables");
+            program.variableNames.push_back(name);
+            assigned.push_back(0);
+        }
+        return found.first->second;
+    }
+
+    uint32_t constantFor(double value) {
+        uint64_t bits;
+        memcpy(&bits, &value, sizeof bits);
+        auto found = constantOf.emplace(bits, static_cast<uint32_t>(program.constants.size()));
+        if (found.second) {
+            checkOperand(program.constants.size(), "constants");
+            program.constants.push_back(value);
+        }
+        return found.first->second;
+    }
+
+    uint32_t failureFor(const string& message) {
+        checkOperand(program.failures.size(), "undefined variable reads");
+        program.failures.push_back(message);
+        return static_cast<uint32_t>(program.failures.size() - 1);
+    }
+
+    static void checkOperand(size_t index, const char* what) {
+        if (index > MAX_OPERAND) throw std::runtime_error(string("Program has too many ") + what + " for bytecode");
+    }
+};
+
+
+Bytecode compileBytecode(const Ast& ast, const LineIndex& lines) {
+    Bytecode program;
+    program.lines = lines;
+    BytecodeCompiler(ast, program).compile();
+    return program;
+}
+
+
+string disassemble(const Bytecode& program) {
+    ostringstream out;
+    for (size_t i = 0; i < program.code.size(); i++) {
+        uint32_t instruction = program.code[i];
+        OpCode op = opcodeOf(instruction);
+        uint32_t operand = operandOf(instruction);
+        out << i << "  " << OPCODE_NAMES[static_cast<size_t>(op)];
+        switch (op) {
+            case OpCode::Const: out << ' ' << operand << "  ; " << program.constants[operand]; break;
+            case OpCode::Load:
+            case OpCode::Store: out << ' ' << operand << "  ; " << program.variableNames[operand]; break;
+            case OpCode::Call:  out << ' ' << operand << "  ; " << builtinName(static_cast<Builtin>(operand)); break;
+            case OpCode::Fail:  out << ' ' << operand << "  ; " << program.failures[operand]; break;
+            default: break;
+        }
+        out << '\n';
+    }
+    return out.str();
+}
+
+
+void BytecodeVM::fail(const Bytecode& program, const uint32_t* ip, const string& message) {
+    // ip is already past the failing instruction
+    size_t at = static_cast<size_t>(ip - program.code.data()) - 1;
+    throw std::runtime_error(runtimeErrorMessage(message, program.offsets[at], program.lines));
+}
+
+
+// The stack is sized by the compiler, so no instruction checks for room.
+// sp points at the top value; stack[0] is never used, which lets a push be
+// *++sp whatever the depth.
+void BytecodeVM::run(const Bytecode& program, vector<double>& printed) {
+    printed.clear();
+    slots.assign(program.variableNames.size(), 0.0);
+    if (stack.size() < program.maxStack + 1) stack.resize(program.maxStack + 1);
+
+    const uint32_t* ip = program.code.data();
+    const double* constants = program.constants.data();
+    double* vars = slots.data();
+    double* sp = stack.data();
+    uint32_t instruction;
+
+#ifdef BYTECODE_COMPUTED_GOTO
+    // In OpCode order
+    static void* const dispatch[] = {
+        &&op_Const, &&op_Load, &&op_Store, &&op_Add, &&op_Sub, &&op_Mul, &&op_Div, &&op_Mod,
+        &&op_Call, &&op_Print, &&op_Fail, &&op_Halt
+    };
+#define VM_CASE(name) op_##name:
+#define VM_NEXT() do { instruction = *ip++; goto *dispatch[instruction & 0xFF]; } while (0)
+    VM_NEXT();
+#else
+#define VM_CASE(name) case OpCode::name:
+#define VM_NEXT() break
+    for (;;) {
+        instruction = *ip++;
+        switch (opcodeOf(instruction)) {
+#endif
+
+    VM_CASE(Const)
+        *++sp = constants[operandOf(instruction)];
+        VM_NEXT();
+    VM_CASE(Load)
+        *++sp = vars[operandOf(instruction)];
+        VM_NEXT();
+    VM_CASE(Store)
+        vars[operandOf(instruction)] = *sp--;
+        VM_NEXT();
+    VM_CASE(Add)
+        sp[-1] = sp[-1] + sp[0];
+        --sp;
+        VM_NEXT();
+    VM_CASE(Sub)
+        sp[-1] = sp[-1] - sp[0];
+        --sp;
+        VM_NEXT();
+    VM_CASE(Mul)
+        sp[-1] = sp[-1] * sp[0];
+        --sp;
+        VM_NEXT();
+    VM_CASE(Div)
+        if (!divide(sp[-1], sp[0], sp[-1])) fail(program, ip, "Division by zero");
+        --sp;
+        VM_NEXT();
+    VM_CASE(Mod)
+        if (!modulo(sp[-1], sp[0], sp[-1])) fail(program, ip, "Modulo by zero");
+        --sp;
+        VM_NEXT();
+    VM_CASE(Call)
+        *sp = callBuiltin(static_cast<Builtin>(operandOf(instruction)), *sp);
+        VM_NEXT();
+    VM_CASE(Print)
+        printed.push_back(*sp--);
+        VM_NEXT();
+    VM_CASE(Fail)
+        throw std::runtime_error(program.failures[operandOf(instruction)]);
+    VM_CASE(Halt)
+        return;
+
+#ifndef BYTECODE_COMPUTED_GOTO
+        }
+    }
+#endif
+#undef VM_CASE
+#undef VM_NEXT
+}
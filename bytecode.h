@@ -0,0 +1,81 @@
+#ifndef BYTECODE_H
+#define BYTECODE_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "ast.h"
+#include "evaluator.h"
+#include "lexical.h"
+
+using namespace std;
+
+// Instructions of the stack machine. Each one is a 32-bit word: the opcode in
+// the low byte and its operand, if any, in the upper 24 bits.
+enum class OpCode : uint8_t {
+    Const,      // push constants[operand]
+    Load,       // push slot operand
+    Store,      // pop into slot operand
+    Add, Sub, Mul, Div, Mod,    // pop right, pop left, push left op right
+    Call,       // replace the top with builtin operand applied to it
+    Print,      // pop and print
+    Fail,       // throw failures[operand]
+    Halt
+};
+
+static const uint32_t MAX_OPERAND = 0xFFFFFF;
+
+inline uint32_t encodeInstruction(OpCode op, uint32_t operand = 0) {
+    return static_cast<uint32_t>(op) | (operand << 8);
+}
+inline OpCode opcodeOf(uint32_t instruction) { return static_cast<OpCode>(instruction & 0xFF); }
+inline uint32_t operandOf(uint32_t instruction) { return instruction >> 8; }
+
+// A program lowered for BytecodeVM. Names are resolved as the Evaluator
+// resolves them: variables to dense slots, calls to builtins; identical
+// numbers share one constant. A read of a variable no earlier statement
+// assigns to compiles to Fail, so it is an error only if it is reached.
+struct Bytecode {
+    vector<uint32_t> code;          // ends with Halt
+    vector<double> constants;
+    vector<string> variableNames;   // per slot
+    vector<string> failures;        // messages of Fail instructions
+
+    // Cold data, read only to report a runtime error: the token offset of
+    // each instruction, and the lines to turn it into a position
+    vector<size_t> offsets;
+    LineIndex lines;
+
+    size_t maxStack = 0;            // deepest the value stack gets
+};
+
+// Throws runtime_error for a call to a function that is not built in, or a
+// program with more constants, variables or failures than an operand holds.
+// The tree is walked without recursion, so nesting is not limited.
+Bytecode compileBytecode(const Ast& ast, const LineIndex& lines = LineIndex());
+
+// One instruction per line, e.g. "4  Const 1  ; 2.5"
+string disassemble(const Bytecode& program);
+
+// Runs Bytecode with the semantics and error messages of the Evaluator.
+// Keeps its value stack and slots between runs, so running the same program
+// over and over allocates nothing. Uses computed-goto dispatch where the
+// compiler has it (GCC, Clang) unless BYTECODE_SWITCH_DISPATCH is defined,
+// and a switch otherwise.
+class BytecodeVM {
+public:
+    // Runs with all variables unset; printed gets the value of every print,
+    // in order. Runtime errors are thrown as runtime_error, after everything
+    // before them has run.
+    void run(const Bytecode& program, vector<double>& printed);
+
+    double variableValue(size_t slot) const { return slots[slot]; }    // as the last run() left it
+
+private:
+    vector<double> stack;
+    vector<double> slots;
+
+    [[noreturn]] static void fail(const Bytecode& program, const uint32_t* ip, const string& message);
+};
+
+#endif
@@ -0,0 +1,195 @@
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include <unordered_map>
+#include <utility>
+#include "evaluator.h"
+
+using namespace std;
+
+// Deepest expression the recursive walk is allowed to reach. Checked once,
+// while resolving, so evaluating needs no depth count.
+static const size_t MAX_EVAL_DEPTH = 2000;
+
+// Operand of a Variable node no earlier statement assigns to
+static const uint32_t UNSET_SLOT = 0xFFFFFFFF;
+
+static const pair<const char*, Builtin> BUILTINS[] = {
+    {"sin", Builtin::Sin}, {"cos", Builtin::Cos}, {"tan", Builtin::Tan}, {"sqrt", Builtin::Sqrt},
+    {"abs", Builtin::Abs}, {"ceil", Builtin::Ceil}, {"floor", Builtin::Floor}
+};
+
+
+bool builtinNamed(const string& name, Builtin& builtin) {
+    for (const auto& entry : BUILTINS) {
+        if (name == entry.first) {
+            builtin = entry.second;
+            return true;
+        }
+    }
+    return false;
+}
+
+
+const char* builtinName(Builtin builtin) {
+    for (const auto& entry : BUILTINS) {
+        if (entry.second == builtin) return entry.first;
+    }
+    return "?";
+}
+
+
+double callBuiltin(Builtin builtin, double x) {
+    switch (builtin) {
+        case Builtin::Sin:   return sin(x);
+        case Builtin::Cos:   return cos(x);
+        case Builtin::Tan:   return tan(x);
+        case Builtin::Sqrt:  return sqrt(x);
+        case Builtin::Abs:   return fabs(x);
+        case Builtin::Ceil:  return ceil(x);
+        case Builtin::Floor: return floor(x);
+    }
+    return x;
+}
+
+
+bool divide(double left, double right, double& result) {
+    if (right == 0) return false;
+    result = left / right;
+    return true;
+}
+
+
+bool modulo(double left, double right, double& result) {
+    if (right == 0) return false;
+    result = fmod(left, right);
+    if (result != 0 && (result < 0) != (right < 0)) result += right;
+    return true;
+}
+
+
+Evaluator::Evaluator(const Ast& tree, const LineIndex& l) : ast(tree), lines(l) {
+    resolve();
+}
+
+
+// Statements run in order and there is no control flow, so whether a read
+// sees an assignment is known before running: it does iff an earlier
+// statement assigns to the name
+void Evaluator::resolve() {
+    unordered_map<string, uint32_t> slotOf;
+    vector<uint8_t> assigned;
+    auto slotFor = [&](const string& name) {
+        auto found = slotOf.emplace(name, static_cast<uint32_t>(names.size()));
+        if (found.second) {
+            names.push_back(name);
+            assigned.push_back(0);
+        }
+        return found.first->second;
+    };
+    auto setOperand = [&](NodeIndex i, uint32_t operand) {
+        if (i >= operands.size()) operands.resize(i + 1, UNSET_SLOT);
+        operands[i] = operand;
+    };
+
+    vector<pair<NodeIndex, size_t>> pending;
+    for (NodeIndex s = ast.firstStatement(); s != NO_NODE; s = ast[s].right) {
+        pending.assign(1, {ast[s].left, 1});
+        while (!pending.empty()) {
+            auto [i, depth] = pending.back();
+            pending.pop_back();
+            const AstNode& n = ast[i];
+            if (depth > MAX_EVAL_DEPTH) throw std::runtime_error(runtimeError("Expression nested too deeply", n));
+
+            switch (n.kind) {
+                case AstKind::Variable: {
+                    uint32_t slot = slotFor(ast.name(n));
+                    setOperand(i, assigned[slot] ? slot : UNSET_SLOT);
+                    break;
+                }
+                case AstKind::Call: {
+                    Builtin builtin;
+                    if (!builtinNamed(ast.name(n), builtin)) {
+                        throw std::runtime_error(runtimeError("Unknown function '" + ast.name(n) + "'", n));
+                    }
+                    setOperand(i, static_cast<uint32_t>(builtin));
+                    pending.push_back({n.left, depth + 1});
+                    break;
+                }
+                case AstKind::Binary:
+                    // Right first, so the left operand's errors are found first
+                    pending.push_back({n.right, depth + 1});
+                    pending.push_back({n.left, depth + 1});
+                    break;
+                default:
+                    break;
+            }
+        }
+
+        if (ast[s].kind == AstKind::Assign) {
+            uint32_t slot = slotFor(ast.name(ast[s]));
+            setOperand(s, slot);
+            assigned[slot] = 1;
+        }
+    }
+    slots.assign(names.size(), 0.0);
+}
+
+
+void Evaluator::run(vector<double>& printed) {
+    printed.clear();
+    fill(slots.begin(), slots.end(), 0.0);
+    for (NodeIndex s = ast.firstStatement(); s != NO_NODE; s = ast[s].right) {
+        const AstNode& statement = ast[s];
+        double value = evaluate(statement.left);
+        if (statement.kind == AstKind::Assign) slots[operands[s]] = value;
+        else printed.push_back(value);
+    }
+}
+
+
+double Evaluator::evaluate(NodeIndex i) const {
+    const AstNode& n = ast[i];
+    switch (n.kind) {
+        case AstKind::Number:
+            return ast.number(n);
+        case AstKind::Variable:
+            if (operands[i] == UNSET_SLOT) {
+                throw std::runtime_error(runtimeError("Variable '" + ast.name(n) + "' is not defined", n));
+            }
+            return slots[operands[i]];
+        case AstKind::Call:
+            return callBuiltin(static_cast<Builtin>(operands[i]), evaluate(n.left));
+        case AstKind::Binary: {
+            double left = evaluate(n.left);
+            double right = evaluate(n.right);
+            double result = 0;
+            switch (n.op) {
+                case '+': return left + right;
+                case '-': return left - right;
+                case '*': return left * right;
+                case '/':
+                    if (!divide(left, right, result)) throw std::runtime_error(runtimeError("Division by zero", n));
+                    return result;
+                case '%':
+                    if (!modulo(left, right, result)) throw std::runtime_error(runtimeError("Modulo by zero", n));
+                    return result;
+            }
+            break;
+        }
+        default:
+            break;
+    }
+    throw std::runtime_error(runtimeError("Cannot evaluate this node", n));
+}
+
+
+string runtimeErrorMessage(const string& message, size_t offset, const LineIndex& lines) {
+    return "Runtime Error: " + message + " at line " + std::to_string(lines.lineAt(offset)) +
+           ", column " + std::to_string(lines.columnAt(offset));
+}
+
+
+string Evaluator::runtimeError(const string& message, const AstNode& at) const {
+    return runtimeErrorMessage(message, ast.token(at).offset, lines);
+}
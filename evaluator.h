@@ -0,0 +1,68 @@
+#ifndef EVALUATOR_H
+#define EVALUATOR_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "ast.h"
+#include "lexical.h"
+
+using namespace std;
+
+// Math functions a FUNCTION token may name
+enum class Builtin : uint8_t { Sin, Cos, Tan, Sqrt, Abs, Ceil, Floor };
+
+bool builtinNamed(const string& name, Builtin& builtin);   // false if not built in
+const char* builtinName(Builtin builtin);                  // as written in programs
+double callBuiltin(Builtin builtin, double argument);
+
+// Arithmetic shared by every way of running a program. Returns false for
+// a zero divisor, which is a runtime error.
+bool divide(double left, double right, double& result);
+bool modulo(double left, double right, double& result);
+
+// "Runtime Error: <message> at line L, column C", for the token at offset
+string runtimeErrorMessage(const string& message, size_t offset, const LineIndex& lines);
+
+// Runs a parsed program by walking its tree. Names are resolved once, when
+// the Evaluator is built: variables to dense slots, calls to builtins, and
+// reads of a variable that no earlier statement assigns to errors.
+//
+// Semantics, following Python where the calculator follows Python:
+//  - All values are doubles; / is true division.
+//  - % takes the sign of the divisor, so -7 % 3 is 2.
+//  - / and % by zero are runtime errors, and so is reading a variable
+//    before any assignment to it.
+//  - The math functions behave as in <cmath>, e.g. sqrt(-1) is nan.
+// Runtime errors are thrown as runtime_error, after everything before them
+// has run.
+class Evaluator {
+public:
+    // The tree and its tokens must outlive the Evaluator. Throws
+    // runtime_error for a call to a function that is not built in, or an
+    // expression nested too deeply to walk.
+    explicit Evaluator(const Ast& ast, const LineIndex& lines = LineIndex());
+
+    // Runs the program with all variables unset; printed gets the value of
+    // every print, in order
+    void run(vector<double>& printed);
+
+    size_t variableCount() const { return names.size(); }
+    const string& variableName(size_t slot) const { return names[slot]; }
+    double variableValue(size_t slot) const { return slots[slot]; }    // as the last run() left it
+
+private:
+    const Ast& ast;
+    LineIndex lines;
+
+    // Per node: the slot of a Variable or Assign, or the builtin of a Call
+    vector<uint32_t> operands;
+    vector<string> names;
+    vector<double> slots;
+
+    void resolve();
+    double evaluate(NodeIndex n) const;
+    string runtimeError(const string& message, const AstNode& at) const;
+};
+
+#endif
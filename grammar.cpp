@@ -0,0 +1,524 @@
+#include <algorithm>
+#include <map>
+#include <sstream>
+#include <stdexcept>
+#include "grammar.h"
+
+using namespace std;
+
+// Symbol ids from 0xFF00 up are reserved for the parser's action markers
+static const size_t MAX_SYMBOLS = 0xFF00;
+static const size_t MAX_PRODUCTIONS = 0x7FFF;
+
+static const char* const DEFAULT_GRAMMAR = R"(
+# Column order of the LL(1) table; "$" (end of input) is added last
+%terminals IDENTIFIER NUMBER print FUNCTION = + - * / % ( )
+
+# {action} entries build the tree and are left out of the grammar proper.
+# Expr' and Term' fold each operand into the left operand as soon as it is
+# parsed, so a - b - c comes out as (a - b) - c.
+S      -> Stmt S | ε
+Stmt   -> IDENTIFIER = Expr {assign}
+        | print ( Expr ) {print}
+Expr   -> Term Expr'
+Expr'  -> + Term {binary} Expr' | - Term {binary} Expr' | ε
+Term   -> Factor Term'
+Term'  -> * Factor {binary} Term' | / Factor {binary} Term' | % Factor {binary} Term' | ε
+Factor -> NUMBER {number}
+        | IDENTIFIER {variable}
+        | FUNCTION ( Expr ) {call}
+        | ( Expr )
+)";
+
+static const char* const DEFAULT_LR_GRAMMAR = R"(
+%terminals IDENTIFIER NUMBER print FUNCTION = + - * / % ( )
+
+# The same language written the natural way for a bottom-up parser. Every
+# {action} ends its production and runs when it is reduced; left recursion
+# makes a - b - c come out as (a - b) - c.
+S      -> S Stmt | ε
+Stmt   -> IDENTIFIER = Expr {assign}
+        | print ( Expr ) {print}
+Expr   -> Expr + Term {binary} | Expr - Term {binary} | Term
+Term   -> Term * Factor {binary} | Term / Factor {binary} | Term % Factor {binary} | Factor
+Factor -> NUMBER {number}
+        | IDENTIFIER {variable}
+        | FUNCTION ( Expr ) {call}
+        | ( Expr )
+)";
+
+
+Symbol Grammar::symbolId(const string& name) const {
+    for (size_t i = 0; i < symbolNames.size(); i++) {
+        if (symbolNames[i] == name) return static_cast<Symbol>(i);
+    }
+    return NO_SYMBOL;
+}
+
+
+string Grammar::productionText(size_t production) const {
+    const GrammarProduction& p = productions[production];
+    string text = symbolNames[p.lhs] + " →";
+    if (p.rhs.empty()) return text + " ε";
+    for (Symbol s : p.rhs) text += " " + symbolNames[s];
+    return text;
+}
+
+
+static bool isAction(const string& item) {
+    return item.size() > 2 && item.front() == '{' && item.back() == '}';
+}
+
+
+Grammar parseGrammar(const string& text) {
+    struct RawProduction {
+        string lhs;
+        vector<string> items;
+    };
+    vector<RawProduction> raw;
+    vector<string> declaredTerminals;
+
+    istringstream in(text);
+    string line;
+    string currentLhs;
+    int lineNo = 0;
+    while (getline(in, line)) {
+        lineNo++;
+        auto fail = [&](const string& why) {
+            throw std::runtime_error("Grammar: " + why + " at line " + std::to_string(lineNo));
+        };
+
+        size_t hash = line.find('#');
+        if (hash != string::npos) line.erase(hash);
+
+        istringstream fields(line);
+        vector<string> words;
+        for (string w; fields >> w;) words.push_back(w);
+        if (words.empty()) continue;
+
+        if (words[0] == "%terminals") {
+            declaredTerminals.insert(declaredTerminals.end(), words.begin() + 1, words.end());
+            continue;
+        }
+
+        // "Lhs -> ..." starts a rule, "| ..." continues the previous one
+        size_t i;
+        if (words.size() >= 2 && words[1] == "->") {
+            currentLhs = words[0];
+            i = 2;
+        } else if (words[0] == "|" && !currentLhs.empty()) {
+            i = 0;
+        } else {
+            fail("expected 'Lhs -> ...' or '| ...'");
+        }
+
+        raw.push_back({currentLhs, {}});
+        if (i == 0) i = 1;
+        for (; i < words.size(); i++) {
+            if (words[i] == "|") raw.push_back({currentLhs, {}});
+            else if (words[i] != "ε") raw.back().items.push_back(words[i]);
+        }
+    }
+    if (raw.empty()) throw std::runtime_error("Grammar: no productions");
+
+    // Nonterminals in order of first definition; terminals as declared, then
+    // in order of first use, then "$"
+    map<string, bool> isNonterminal;
+    vector<string> nonterminals;
+    for (const RawProduction& p : raw) {
+        if (!isNonterminal[p.lhs]) nonterminals.push_back(p.lhs);
+        isNonterminal[p.lhs] = true;
+    }
+
+    Grammar g;
+    map<string, Symbol> ids;
+    auto addTerminal = [&](const string& name) {
+        if (name == "$" || ids.count(name)) return;
+        if (isNonterminal[name]) throw std::runtime_error("Grammar: terminal '" + name + "' has productions");
+        ids[name] = static_cast<Symbol>(g.symbolNames.size());
+        g.symbolNames.push_back(name);
+    };
+    for (const string& t : declaredTerminals) addTerminal(t);
+    for (const RawProduction& p : raw) {
+        for (const string& item : p.items) {
+            if (!isAction(item) && !isNonterminal[item]) addTerminal(item);
+        }
+    }
+    g.endMarker = static_cast<Symbol>(g.symbolNames.size());
+    ids["$"] = g.endMarker;
+    g.symbolNames.push_back("$");
+    g.terminalCount = g.symbolNames.size();
+
+    for (const string& nt : nonterminals) {
+        ids[nt] = static_cast<Symbol>(g.symbolNames.size());
+        g.symbolNames.push_back(nt);
+    }
+    if (g.symbolNames.size() > MAX_SYMBOLS) throw std::runtime_error("Grammar: too many symbols");
+    if (raw.size() > MAX_PRODUCTIONS) throw std::runtime_error("Grammar: too many productions");
+
+    g.start = ids[raw.front().lhs];
+    for (RawProduction& p : raw) {
+        GrammarProduction production;
+        production.lhs = ids[p.lhs];
+        for (const string& item : p.items) {
+            if (!isAction(item)) production.rhs.push_back(ids[item]);
+        }
+        production.items = std::move(p.items);
+        g.productions.push_back(std::move(production));
+    }
+    return g;
+}
+
+
+Grammar defaultGrammar() {
+    return parseGrammar(DEFAULT_GRAMMAR);
+}
+
+
+Grammar defaultLRGrammar() {
+    return parseGrammar(DEFAULT_LR_GRAMMAR);
+}
+
+
+bool TerminalSet::insert(size_t t) {
+    uint64_t bit = uint64_t(1) << (t % 64);
+    if (words[t / 64] & bit) return false;
+    words[t / 64] |= bit;
+    return true;
+}
+
+
+bool TerminalSet::merge(const TerminalSet& other) {
+    bool changed = false;
+    for (size_t i = 0; i < words.size(); i++) {
+        uint64_t merged = words[i] | other.words[i];
+        changed |= merged != words[i];
+        words[i] = merged;
+    }
+    return changed;
+}
+
+
+// Plain fixpoint iteration: sweep the productions until no set grows
+FirstFollowSets computeFirstFollow(const Grammar& g) {
+    size_t n = g.nonterminalCount();
+    size_t base = g.terminalCount;
+    FirstFollowSets sets;
+    sets.first.assign(n, TerminalSet(g.terminalCount));
+    sets.follow.assign(n, TerminalSet(g.terminalCount));
+    sets.nullable.assign(n, 0);
+
+    for (bool changed = true; changed;) {
+        changed = false;
+        for (const GrammarProduction& p : g.productions) {
+            TerminalSet& first = sets.first[p.lhs - base];
+            bool allNullable = true;
+            for (Symbol s : p.rhs) {
+                if (g.isTerminal(s)) {
+                    changed |= first.insert(s);
+                    allNullable = false;
+                    break;
+                }
+                changed |= first.merge(sets.first[s - base]);
+                if (!sets.nullable[s - base]) {
+                    allNullable = false;
+                    break;
+                }
+            }
+            if (allNullable && !sets.nullable[p.lhs - base]) {
+                sets.nullable[p.lhs - base] = 1;
+                changed = true;
+            }
+        }
+    }
+
+    sets.follow[g.start - base].insert(g.endMarker);
+    for (bool changed = true; changed;) {
+        changed = false;
+        for (const GrammarProduction& p : g.productions) {
+            // What may follow the symbol at i: FIRST of the rest, plus
+            // FOLLOW(lhs) while the rest is nullable
+            TerminalSet trailer = sets.follow[p.lhs - base];
+            for (size_t i = p.rhs.size(); i > 0; --i) {
+                Symbol s = p.rhs[i - 1];
+                if (g.isTerminal(s)) {
+                    trailer = TerminalSet(g.terminalCount);
+                    trailer.insert(s);
+                    continue;
+                }
+                changed |= sets.follow[s - base].merge(trailer);
+                if (!sets.nullable[s - base]) trailer = TerminalSet(g.terminalCount);
+                trailer.merge(sets.first[s - base]);
+            }
+        }
+    }
+    return sets;
+}
+
+
+LL1Table buildLL1Table(const Grammar& g) {
+    FirstFollowSets sets = computeFirstFollow(g);
+    size_t base = g.terminalCount;
+
+    LL1Table table;
+    table.terminalCount = g.terminalCount;
+    table.nonterminalCount = g.nonterminalCount();
+    table.entries.assign(table.terminalCount * table.nonterminalCount, -1);
+
+    for (size_t index = 0; index < g.productions.size(); index++) {
+        const GrammarProduction& p = g.productions[index];
+        int16_t production = static_cast<int16_t>(index);
+
+        // FIRST of the right-hand side, and whether it can vanish
+        TerminalSet lookaheads(g.terminalCount);
+        bool nullable = true;
+        for (Symbol s : p.rhs) {
+            if (g.isTerminal(s)) {
+                lookaheads.insert(s);
+                nullable = false;
+                break;
+            }
+            lookaheads.merge(sets.first[s - base]);
+            if (!sets.nullable[s - base]) {
+                nullable = false;
+                break;
+            }
+        }
+        if (nullable) lookaheads.merge(sets.follow[p.lhs - base]);
+
+        for (size_t t = 0; t < g.terminalCount; t++) {
+            if (!lookaheads.contains(t)) continue;
+            int16_t& cell = table.entries[(p.lhs - base) * table.terminalCount + t];
+            if (cell < 0) {
+                cell = production;
+            } else if (cell != production) {
+                table.conflicts.push_back({p.lhs, static_cast<Symbol>(t), cell, production});
+            }
+        }
+    }
+    return table;
+}
+
+
+string describeConflict(const Grammar& g, const LL1Conflict& c) {
+    return "LL(1) conflict on " + g.symbolNames[c.nonterminal] + " with lookahead " +
+           g.symbolNames[c.terminal] + ": " + g.productionText(c.kept) +
+           " vs " + g.productionText(c.rejected);
+}
+
+
+// --- LALR(1) ---
+
+// An LR(0) item is a production and a dot position, packed so a sorted
+// vector of them identifies a state's kernel
+static uint32_t makeItem(size_t production, size_t dot) { return static_cast<uint32_t>(production << 16 | dot); }
+static size_t itemProduction(uint32_t item) { return item >> 16; }
+static size_t itemDot(uint32_t item) { return item & 0xFFFF; }
+
+// An LR(1) item set entry: the lookaheads, and whether the lookaheads of the
+// kernel item it was closed from reach it (the "#" of algorithm 4.62)
+struct LookaheadItem {
+    uint32_t item;
+    TerminalSet lookaheads;
+    bool propagates;
+};
+
+// The grammar with the augmented production S' -> S appended, so items can
+// refer to it like any other
+struct AugmentedGrammar {
+    const Grammar& g;
+    FirstFollowSets sets;
+    vector<vector<Symbol>> rhs;
+    vector<vector<size_t>> productionsOf;      // by nonterminal - terminalCount
+    size_t augmented;
+
+    explicit AugmentedGrammar(const Grammar& grammar)
+        : g(grammar), sets(computeFirstFollow(grammar)), productionsOf(grammar.nonterminalCount()) {
+        for (size_t p = 0; p < g.productions.size(); p++) {
+            rhs.push_back(g.productions[p].rhs);
+            productionsOf[g.productions[p].lhs - g.terminalCount].push_back(p);
+        }
+        augmented = rhs.size();
+        rhs.push_back({ g.start });
+    }
+
+    // Symbol after the dot, NO_SYMBOL at the end
+    Symbol next(uint32_t item) const {
+        const vector<Symbol>& r = rhs[itemProduction(item)];
+        return itemDot(item) < r.size() ? r[itemDot(item)] : NO_SYMBOL;
+    }
+};
+
+
+static vector<uint32_t> closeItems(const AugmentedGrammar& a, vector<uint32_t> items) {
+    vector<uint8_t> expanded(a.g.nonterminalCount(), 0);
+    for (size_t i = 0; i < items.size(); i++) {
+        Symbol next = a.next(items[i]);
+        if (next == NO_SYMBOL || a.g.isTerminal(next) || expanded[next - a.g.terminalCount]) continue;
+        expanded[next - a.g.terminalCount] = 1;
+        for (size_t p : a.productionsOf[next - a.g.terminalCount]) items.push_back(makeItem(p, 0));
+    }
+    return items;
+}
+
+
+// LR(1) closure: [A -> α . B β, L] adds [B -> . γ, FIRST(β L)] until
+// nothing changes
+static vector<LookaheadItem> closeLookaheads(const AugmentedGrammar& a, vector<LookaheadItem> items) {
+    map<uint32_t, size_t> index;
+    for (size_t i = 0; i < items.size(); i++) index[items[i].item] = i;
+
+    size_t base = a.g.terminalCount;
+    for (bool changed = true; changed;) {
+        changed = false;
+        for (size_t i = 0; i < items.size(); i++) {
+            Symbol next = a.next(items[i].item);
+            if (next == NO_SYMBOL || a.g.isTerminal(next)) continue;
+
+            const vector<Symbol>& r = a.rhs[itemProduction(items[i].item)];
+            TerminalSet lookaheads(a.g.terminalCount);
+            bool nullable = true;
+            for (size_t k = itemDot(items[i].item) + 1; k < r.size() && nullable; k++) {
+                if (a.g.isTerminal(r[k])) {
+                    lookaheads.insert(r[k]);
+                    nullable = false;
+                } else {
+                    lookaheads.merge(a.sets.first[r[k] - base]);
+                    nullable = a.sets.nullable[r[k] - base];
+                }
+            }
+            bool propagates = nullable && items[i].propagates;
+            if (nullable) lookaheads.merge(items[i].lookaheads);
+
+            for (size_t p : a.productionsOf[next - base]) {
+                auto found = index.find(makeItem(p, 0));
+                if (found == index.end()) {
+                    index[makeItem(p, 0)] = items.size();
+                    items.push_back({ makeItem(p, 0), lookaheads, propagates });
+                    changed = true;
+                } else {
+                    LookaheadItem& existing = items[found->second];
+                    changed |= existing.lookaheads.merge(lookaheads);
+                    if (propagates && !existing.propagates) {
+                        existing.propagates = true;
+                        changed = true;
+                    }
+                }
+            }
+        }
+    }
+    return items;
+}
+
+
+LRTable buildLALRTable(const Grammar& g) {
+    AugmentedGrammar a(g);
+    size_t symbolCount = g.symbolNames.size();
+
+    // LR(0) collection. States are numbered in order of discovery, their
+    // successors on each symbol in symbol order.
+    vector<vector<uint32_t>> kernels = { { makeItem(a.augmented, 0) } };
+    map<vector<uint32_t>, uint32_t> stateOf = { { kernels[0], 0 } };
+    vector<vector<int32_t>> successors;
+    for (size_t s = 0; s < kernels.size(); s++) {
+        map<Symbol, vector<uint32_t>> moved;
+        for (uint32_t item : closeItems(a, kernels[s])) {
+            Symbol next = a.next(item);
+            if (next != NO_SYMBOL) moved[next].push_back(item + 1);
+        }
+        successors.emplace_back(symbolCount, -1);
+        for (auto& [symbol, kernel] : moved) {
+            sort(kernel.begin(), kernel.end());
+            kernel.erase(unique(kernel.begin(), kernel.end()), kernel.end());
+            auto found = stateOf.find(kernel);
+            if (found == stateOf.end()) {
+                found = stateOf.emplace(kernel, static_cast<uint32_t>(kernels.size())).first;
+                kernels.push_back(kernel);
+            }
+            successors[s][symbol] = static_cast<int32_t>(found->second);
+        }
+    }
+
+    // Kernel items are numbered across all states for the lookahead pass
+    vector<size_t> firstKernelItem = { 0 };
+    for (const vector<uint32_t>& kernel : kernels) firstKernelItem.push_back(firstKernelItem.back() + kernel.size());
+    auto kernelItemId = [&](size_t state, uint32_t item) {
+        const vector<uint32_t>& kernel = kernels[state];
+        return firstKernelItem[state] + (lower_bound(kernel.begin(), kernel.end(), item) - kernel.begin());
+    };
+
+    // Lookaheads each kernel item generates for its successors, and where
+    // its own lookaheads propagate to
+    vector<TerminalSet> lookaheads(firstKernelItem.back(), TerminalSet(g.terminalCount));
+    vector<vector<size_t>> propagatesTo(firstKernelItem.back());
+    lookaheads[0].insert(g.endMarker);
+    for (size_t s = 0; s < kernels.size(); s++) {
+        for (uint32_t kernelItem : kernels[s]) {
+            size_t from = kernelItemId(s, kernelItem);
+            vector<LookaheadItem> closure = closeLookaheads(a, { { kernelItem, TerminalSet(g.terminalCount), true } });
+            for (const LookaheadItem& c : closure) {
+                Symbol next = a.next(c.item);
+                if (next == NO_SYMBOL) continue;
+                size_t to = kernelItemId(successors[s][next], c.item + 1);
+                lookaheads[to].merge(c.lookaheads);
+                if (c.propagates) propagatesTo[from].push_back(to);
+            }
+        }
+    }
+    for (bool changed = true; changed;) {
+        changed = false;
+        for (size_t from = 0; from < propagatesTo.size(); from++) {
+            for (size_t to : propagatesTo[from]) changed |= lookaheads[to].merge(lookaheads[from]);
+        }
+    }
+
+    LRTable table;
+    table.terminalCount = g.terminalCount;
+    table.nonterminalCount = g.nonterminalCount();
+    table.stateCount = kernels.size();
+    table.actions.assign(table.stateCount * table.terminalCount, LR_ERROR);
+    table.gotos.assign(table.stateCount * table.nonterminalCount, -1);
+
+    auto setAction = [&](size_t state, Symbol terminal, int32_t action) {
+        int32_t& cell = table.actions[state * table.terminalCount + terminal];
+        if (cell == LR_ERROR || cell == action) {
+            cell = action;
+            return;
+        }
+        // Reductions are negative and the earlier production the larger
+        bool replace = (action > 0 && cell < 0) || (action < 0 && cell < 0 && action > cell);
+        table.conflicts.push_back({ static_cast<uint32_t>(state), terminal, replace ? action : cell, replace ? cell : action });
+        if (replace) cell = action;
+    };
+
+    for (size_t s = 0; s < kernels.size(); s++) {
+        vector<LookaheadItem> items;
+        for (uint32_t kernelItem : kernels[s]) items.push_back({ kernelItem, lookaheads[kernelItemId(s, kernelItem)], false });
+        for (const LookaheadItem& item : closeLookaheads(a, std::move(items))) {
+            Symbol next = a.next(item.item);
+            if (next != NO_SYMBOL) {
+                if (g.isTerminal(next)) setAction(s, next, successors[s][next] + 1);
+                else table.gotos[s * table.nonterminalCount + next - g.terminalCount] = successors[s][next];
+                continue;
+            }
+            size_t production = itemProduction(item.item);
+            for (size_t t = 0; t < g.terminalCount; t++) {
+                if (!item.lookaheads.contains(t)) continue;
+                setAction(s, static_cast<Symbol>(t),
+                          production == a.augmented ? LR_ACCEPT : -static_cast<int32_t>(production) - 1);
+            }
+        }
+    }
+    return table;
+}
+
+
+string describeConflict(const Grammar& g, const LRConflict& c) {
+    auto describe = [&](int32_t action) {
+        if (action > 0) return string("shift");
+        if (action == LR_ACCEPT) return string("accept");
+        return "reduce " + g.productionText(static_cast<size_t>(-action - 1));
+    };
+    return "LALR(1) conflict in state " + std::to_string(c.state) + " with lookahead " +
+           g.symbolNames[c.terminal] + ": " + describe(c.kept) + " vs " + describe(c.rejected);
+}
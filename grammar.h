@@ -0,0 +1,122 @@
+#ifndef GRAMMAR_H
+#define GRAMMAR_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+// Grammar symbols are interned to small integers: terminals first, then
+// nonterminals, so a symbol is a terminal iff it is below terminalCount.
+typedef uint16_t Symbol;
+static const Symbol NO_SYMBOL = 0xFFFF;
+
+struct GrammarProduction {
+    Symbol lhs;
+    vector<Symbol> rhs;
+    vector<string> items;       // right-hand side as written, {actions} included
+};
+
+struct Grammar {
+    vector<string> symbolNames;
+    size_t terminalCount = 0;
+    Symbol start = NO_SYMBOL;
+    Symbol endMarker = NO_SYMBOL;           // "$", always the last terminal
+    vector<GrammarProduction> productions;  // in spec order
+
+    Symbol symbolId(const string& name) const;   // NO_SYMBOL if unknown
+    bool isTerminal(Symbol s) const { return s < terminalCount; }
+    size_t nonterminalCount() const { return symbolNames.size() - terminalCount; }
+    string productionText(size_t production) const;   // "A → α"
+};
+
+// Spec format, '#' starts a comment:
+//   %terminals IDENTIFIER NUMBER ( )    optional, fixes the terminal order
+//   Lhs -> a B {action} | ε             one or more lines per nonterminal
+// The first rule's left-hand side is the start symbol. Symbols that never
+// appear on a left-hand side are terminals. {name} entries are semantic
+// actions: carried along in GrammarProduction::items, ignored by the
+// analysis. Throws runtime_error on malformed specs.
+Grammar parseGrammar(const string& text);
+Grammar defaultGrammar();                   // the calculator language
+Grammar defaultLRGrammar();                 // the same, left-recursive, for LRParser
+
+// Set of terminals, one bit each
+class TerminalSet {
+public:
+    explicit TerminalSet(size_t terminals = 0) : words((terminals + 63) / 64, 0) {}
+
+    bool contains(size_t t) const { return (words[t / 64] >> (t % 64)) & 1; }
+    bool insert(size_t t);
+    bool merge(const TerminalSet& other);   // returns whether anything was added
+
+private:
+    vector<uint64_t> words;
+};
+
+// FIRST and FOLLOW of every nonterminal, indexed by symbol - terminalCount
+struct FirstFollowSets {
+    vector<TerminalSet> first;
+    vector<TerminalSet> follow;
+    vector<uint8_t> nullable;
+};
+
+FirstFollowSets computeFirstFollow(const Grammar& grammar);
+
+// Two productions competing for one table cell; the earlier one is kept
+struct LL1Conflict {
+    Symbol nonterminal;
+    Symbol terminal;
+    int16_t kept;
+    int16_t rejected;
+};
+
+struct LL1Table {
+    size_t terminalCount = 0;
+    size_t nonterminalCount = 0;
+    vector<int16_t> entries;            // [nonterminal][terminal] -> production, -1 = error
+    vector<LL1Conflict> conflicts;
+
+    int16_t at(Symbol nonterminal, Symbol terminal) const {
+        return entries[(nonterminal - terminalCount) * terminalCount + terminal];
+    }
+};
+
+LL1Table buildLL1Table(const Grammar& grammar);
+string describeConflict(const Grammar& grammar, const LL1Conflict& conflict);
+
+// LALR(1) actions, one int32_t per cell: shift to state s is s + 1, reduce
+// by production p is -(p + 1)
+static const int32_t LR_ERROR = 0;
+static const int32_t LR_ACCEPT = INT32_MIN;
+
+// Two actions competing for one table cell. Shift wins over reduce and the
+// earlier production over the later one, as in yacc.
+struct LRConflict {
+    uint32_t state;
+    Symbol terminal;
+    int32_t kept;
+    int32_t rejected;
+};
+
+struct LRTable {
+    size_t terminalCount = 0;
+    size_t nonterminalCount = 0;
+    size_t stateCount = 0;
+    vector<int32_t> actions;            // [state][terminal]
+    vector<int32_t> gotos;              // [state][nonterminal] -> state, -1 = none
+    vector<LRConflict> conflicts;
+
+    int32_t action(size_t state, Symbol terminal) const { return actions[state * terminalCount + terminal]; }
+    int32_t goTo(size_t state, Symbol nonterminal) const {
+        return gotos[state * nonterminalCount + nonterminal - terminalCount];
+    }
+};
+
+// LR(0) states with LALR(1) lookaheads, found by propagating them between
+// kernel items (Dragon book, algorithm 4.63). State 0 is the start state.
+LRTable buildLALRTable(const Grammar& grammar);
+string describeConflict(const Grammar& grammar, const LRConflict& conflict);
+
+#endif
@@ -230,24 +230,10 @@ LexicalVisualizer::LexicalVisualizer(QWidget *parent) : QWidget(parent) {
 
 
 void LexicalVisualizer::setupDFA() {
-    // 1. Create NFAs for all token types
-    std::vector<NFA> nfas;
-    nfas.push_back(createIdentifierNFA());
-    nfas.push_back(createNumberNFA());
-    nfas.push_back(createSingleCharNFA('%', MOD));
-    nfas.push_back(createSingleCharNFA('+', PLUS));
-    nfas.push_back(createSingleCharNFA('-', MINUS));
-    nfas.push_back(createSingleCharNFA('*', MULTIPLY));
-    nfas.push_back(createSingleCharNFA('/', DIVIDE));
-    nfas.push_back(createSingleCharNFA('=', ASSIGN));
-    nfas.push_back(createSingleCharNFA('(', LPAREN));
-    nfas.push_back(createSingleCharNFA(')', RPAREN));
-    
-    // 2. Combine all NFAs into one master NFA
-    NFA masterNFA = combineNFAs(nfas);
-
-    // 3. Convert master NFA to DFA
-    dfa = convertNFAtoDFA(masterNFA);
+    // Build the identifier/number/operator NFAs, combine them and convert
+    // to a DFA; the lexer owns the states, dfa is a view for drawing.
+    lexer = buildLexer(defaultTokenRules());
+    dfa = lexer->dfa;
 }
 
 
@@ -557,7 +543,8 @@ void LexicalVisualizer::updateTokenList(const Token& token) {
     QTableWidgetItem* typeItem = new QTableWidgetItem(tokenName);
     tokenTableWidget->setItem(row, 1, typeItem);
 
-    qDebug() << "Token" << token.lexeme << "is on line" << token.line;
+    qDebug() << "Token" << token.lexeme << "is on line" << lineIndex.lineAt(token.offset)
+             << "column" << lineIndex.columnAt(token.offset);
 
     // Clear previous highlight
     finalTokens.push_back(token);
@@ -573,7 +560,6 @@ void LexicalVisualizer::resetClicked(){
     currentScanPos = 0;
     traversalIndex = 0;
     isTraversing = false;
-    currentline = 1;
 
 
     // Highlight start state
@@ -598,11 +584,11 @@ void LexicalVisualizer::tokenizeClicked(){
 
     if (input.isEmpty()) return;
     rawInputString = input;
+    lineIndex = LineIndex(input.toStdString());
 
     currentScanPos = 0;
     traversalIndex = 0;
     isTraversing = false;
-    currentline = 1;
 
 
     tokenizeButton->setEnabled(false);
@@ -649,9 +635,6 @@ void LexicalVisualizer::autoTraverse() {
     string text = inputEditor->toPlainText().toStdString();
 
     while (currentScanPos < text.size() && std::isspace(static_cast<unsigned char>(text[currentScanPos]))) {
-        if (input[currentScanPos] == '\n') {
-            currentline++;
-        }
         currentScanPos++;
     }
 
@@ -676,7 +659,7 @@ void LexicalVisualizer::autoTraverse() {
         // --- PHASE 1: START SCAN FOR NEXT TOKEN ---
         
         // 1. Scan for the next token and reset traversal index
-        currentResult = scanNextToken(dfa, input.toStdString(), currentScanPos, currentline);
+        currentResult = scanNextToken(*lexer, input.toStdString(), currentScanPos);
         traversalIndex = 0;
         isTraversing = true;
 
@@ -718,7 +701,7 @@ void LexicalVisualizer::autoTraverse() {
         Token errorToken = {
             UNKNOWN,
             input.mid(currentScanPos, unknownEnd - currentScanPos).toStdString(),
-            currentline
+            currentScanPos
         };
         updateTokenList(errorToken);
         highlightInput(currentScanPos, unknownEnd);
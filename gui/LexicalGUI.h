@@ -68,11 +68,12 @@ private:
 
     
     // --- Lexical/DFA Data ---
+    shared_ptr<const CompiledLexer> lexer;
     DFA dfa;
     DFAState* walkState = nullptr;
     size_t walkPos = 0;
     QMap<int, StateNode*> stateNodes; 
-    int currentline = 1;
+    LineIndex lineIndex;
 
 
     QMap<QPair<int,int>, QGraphicsItemGroup*> transitionGroups;
@@ -14,6 +14,7 @@
 #include <QColor>
 #include <QTextEdit>
 #include <QRegularExpression>
+#include "../grammar.h"
 
 
 PDAStateNode::PDAStateNode(QString label, bool isAccepting) : accepting(isAccepting) {
@@ -699,14 +700,17 @@ void PDAVisualizer::displayGrammar() {
 
 
 void PDAVisualizer::setupParsingTable() {
-    QStringList nonTerminals = {
-        "S", "Stmt", "Expr", "Expr'", "Term", "Term'", "Factor"
-    };
+    // Generated from the same grammar the parser uses
+    Grammar grammar = defaultGrammar();
+    LL1Table table = buildLL1Table(grammar);
 
-    QStringList terminals = {
-        "IDENTIFIER", "NUMBER", "print", "FUNCTION",
-        "=", "+", "-", "*", "/", "%", "(", ")", "$"
-    };
+    QStringList nonTerminals;
+    for (size_t i = grammar.terminalCount; i < grammar.symbolNames.size(); ++i)
+        nonTerminals << QString::fromStdString(grammar.symbolNames[i]);
+
+    QStringList terminals;
+    for (size_t i = 0; i < grammar.terminalCount; ++i)
+        terminals << QString::fromStdString(grammar.symbolNames[i]);
 
     parsingTable->clear();
     parsingTable->setRowCount(nonTerminals.size());
@@ -722,45 +726,17 @@ void PDAVisualizer::setupParsingTable() {
     parsingTable->horizontalHeader()->setSectionResizeMode(QHeaderView::Stretch);
     parsingTable->verticalHeader()->setSectionResizeMode(QHeaderView::ResizeToContents);
 
-    auto setRule = [&](const QString& nt, const QString& t, const QString& rule) {
-        int r = nonTerminals.indexOf(nt);
-        int c = terminals.indexOf(t);
-        if (r < 0 || c < 0) return;
-
-        QTableWidgetItem* item = new QTableWidgetItem(rule);
-        item->setTextAlignment(Qt::AlignCenter | Qt::TextWordWrap);
-        item->setFlags(Qt::ItemIsEnabled);
-        parsingTable->setItem(r, c, item);
-    };
-
-    setRule("S", "IDENTIFIER", "S → Stmt S");
-    setRule("S", "print", "S → Stmt S");
-    setRule("S", "$", "S → ε");
-
-    setRule("Stmt", "IDENTIFIER", "Stmt → IDENTIFIER = Expr");
-    setRule("Stmt", "print", "Stmt → print ( Expr )");
+    for (int r = 0; r < nonTerminals.size(); ++r) {
+        for (int c = 0; c < terminals.size(); ++c) {
+            int16_t production = table.entries[r * table.terminalCount + c];
+            if (production < 0) continue;
 
-    for (const QString& t : {"IDENTIFIER", "NUMBER", "FUNCTION", "("})
-        setRule("Expr", t, "Expr → Term Expr'");
-
-    setRule("Expr'", "+", "Expr' → + Term Expr'");
-    setRule("Expr'", "-", "Expr' → - Term Expr'");
-    for (const QString& t : {")", "$"})
-        setRule("Expr'", t, "Expr' → ε");
-
-    for (const QString& t : {"IDENTIFIER", "NUMBER", "FUNCTION", "("})
-        setRule("Term", t, "Term → Factor Term'");
-
-    setRule("Term'", "*", "Term' → * Factor Term'");
-    setRule("Term'", "/", "Term' → / Factor Term'");
-    setRule("Term'", "%", "Term' → % Factor Term'");
-    for (const QString& t : {"+", "-", ")", "$"})
-        setRule("Term'", t, "Term' → ε");
-
-    setRule("Factor", "NUMBER", "Factor → NUMBER");
-    setRule("Factor", "IDENTIFIER", "Factor → IDENTIFIER");
-    setRule("Factor", "FUNCTION", "Factor → FUNCTION ( Expr )");
-    setRule("Factor", "(", "Factor → ( Expr )");
+            QTableWidgetItem* item = new QTableWidgetItem(QString::fromStdString(grammar.productionText(production)));
+            item->setTextAlignment(Qt::AlignCenter | Qt::TextWordWrap);
+            item->setFlags(Qt::ItemIsEnabled);
+            parsingTable->setItem(r, c, item);
+        }
+    }
 
     parsingTable->resizeRowsToContents();
     parsingTable->resizeColumnsToContents();
@@ -277,10 +277,9 @@ void SyntacticVisualizer::parseClicked() {
     }
 
     // Prepare tokens
-    vector<Token> tokensToParse = currentTokens;
-    if (tokensToParse.empty() || tokensToParse.back().value != "$") {
-        tokensToParse.push_back({UNKNOWN, "$", 1}); 
-    }
+    // The parser supplies the end-of-input "$" itself and reads
+    // currentTokens in place, so they must stay put until clearState()
+    string source = currentInputString.toStdString();
 
     // Reset UI state
     if (traversalTimer) traversalTimer->stop();
@@ -291,15 +290,16 @@ void SyntacticVisualizer::parseClicked() {
     traceTableWidget->setRowCount(0);
     stackWidget->clear();
 
-    parser = new Parser(tokensToParse);
+    parser = new Parser(currentTokens, LineIndex(source));
+    MemoryTraceSink capture;
     
     try {
-        parser->parse(); 
+        parser->parse(capture); 
     } catch (const exception& e) {
         pendingErrorMessage = QString::fromStdString(e.what());
     }
 
-    trace = parser->getTrace();
+    trace = capture.take();
     
     if (!trace.empty()) {
         parseButton->setEnabled(false);
@@ -389,7 +389,7 @@ void SyntacticVisualizer::autoTraverse()
 
 
     const PDAAction& step = trace[traversalIndex];
-    QString actionStr = QString::fromStdString(step.action);
+    QString actionStr = QString::fromStdString(*step.action);
     QString state = "q2"; 
 
     QString rawAction = actionStr.toLower();
@@ -409,14 +409,15 @@ void SyntacticVisualizer::autoTraverse()
 
     pdaDiagramView->updateVisualization(
         state,
-        QString::fromStdString(step.currentToken.value),
-        step.stack.empty() ? "" : QString::fromStdString(step.stack.back()),
+        QString::fromStdString(step.currentToken->value),
+        QString::fromStdString(step.topSymbol()),
         actionStr
     );
 
 
+    const vector<string> stepStack = step.stackContents();
     stackWidget->clear();
-    for (auto it = step.stack.rbegin(); it != step.stack.rend(); ++it) {
+    for (auto it = stepStack.rbegin(); it != stepStack.rend(); ++it) {
         QListWidgetItem* item =
             new QListWidgetItem(QString::fromStdString(*it));
         item->setTextAlignment(Qt::AlignCenter);
@@ -429,7 +430,7 @@ void SyntacticVisualizer::autoTraverse()
 
     // STACK column (top on left)
     QString stackStr;
-    for (auto it = step.stack.rbegin(); it != step.stack.rend(); ++it) {
+    for (auto it = stepStack.rbegin(); it != stepStack.rend(); ++it) {
         stackStr += QString::fromStdString(*it) + " ";
     }
 
@@ -482,10 +483,10 @@ void SyntacticVisualizer::updateTraceTable(const vector<PDAAction>& traceData) {
     traceTableWidget->setRowCount(traceData.size());
     for (int i = 0; i < traceData.size(); ++i) {
         const PDAAction& action = traceData[i];
-        traceTableWidget->setItem(i, 0, new QTableWidgetItem(QString::fromStdString(action.action)));
-        traceTableWidget->setItem(i, 1, new QTableWidgetItem(QString::fromStdString(action.currentToken.value)));
+        traceTableWidget->setItem(i, 0, new QTableWidgetItem(QString::fromStdString(*action.action)));
+        traceTableWidget->setItem(i, 1, new QTableWidgetItem(QString::fromStdString(action.currentToken->value)));
         QString stackStr;
-        for (auto& s : action.stack) stackStr += QString::fromStdString(s) + " ";
+        for (auto& s : action.stackContents()) stackStr += QString::fromStdString(s) + " ";
         traceTableWidget->setItem(i, 2, new QTableWidgetItem(stackStr.trimmed()));
     }
 }
@@ -497,7 +498,8 @@ void SyntacticVisualizer::updateStateAtCurrentIndex() {
     const PDAAction& step = trace[traversalIndex];
 
     // --- 1. Update Stack Widget ---
-    updateStackDisplay(step.stack);
+    const vector<string> stepStack = step.stackContents();
+    updateStackDisplay(stepStack);
 
     // --- 2. Update Trace Table (Highlight current row) ---
     traceTableWidget->selectRow(traversalIndex);
@@ -505,7 +507,7 @@ void SyntacticVisualizer::updateStateAtCurrentIndex() {
     QString pdaAction; 
     // --- 3. Update PDA Diagram ---
     QString state = "q2"; 
-    QString actionStr = QString::fromStdString(step.action);
+    QString actionStr = QString::fromStdString(*step.action);
     QString pdaLabel = actionStr;
 
 
@@ -523,7 +525,7 @@ void SyntacticVisualizer::updateStateAtCurrentIndex() {
         pdaLabel = "ε, $ → S";
     } else if (actionStr.contains("match", Qt::CaseInsensitive)) {
         // IMPORTANT: Format this to match your terminal edge label: "terminal, terminal → ε"
-        QString terminal = QString::fromStdString(step.currentToken.value);
+        QString terminal = QString::fromStdString(step.currentToken->value);
         pdaLabel = QString("%1, %1 → ε").arg(terminal);
     } else if (actionStr.contains("ACCEPT", Qt::CaseInsensitive)) {
         state = "q3";
@@ -532,13 +534,13 @@ void SyntacticVisualizer::updateStateAtCurrentIndex() {
     // Trigger the PDA highlight
     pdaDiagramView->updateVisualization(
         state, 
-        QString::fromStdString(step.currentToken.value), 
-        step.stack.empty() ? "" : QString::fromStdString(step.stack.back()), 
+        QString::fromStdString(step.currentToken->value), 
+        QString::fromStdString(step.topSymbol()), 
         actionStr
     );
 
     if (!actionStr.contains("Expand")) {
-        updateStackDisplay(step.stack);
+        updateStackDisplay(stepStack);
     }
 }
 
@@ -575,15 +577,16 @@ void SyntacticVisualizer::addTableRow(int index) {
     traceTableWidget->insertRow(row);
 
     // 1. Stack Column (Top on Left)
+    const vector<string> stepStack = step.stackContents();
     QString stackStr;
-    for (auto it = step.stack.rbegin(); it != step.stack.rend(); ++it)
+    for (auto it = stepStack.rbegin(); it != stepStack.rend(); ++it)
         stackStr += QString::fromStdString(*it) + " ";
 
     // 2. NEW: Calculate Full Remaining Input String
     // We determine the current position by counting 'match' actions up to this index
     int matchCount = 0;
     for (int i = 0; i < index; ++i) {
-        if (QString::fromStdString(trace[i].action).toLower().contains("match")) {
+        if (QString::fromStdString(*trace[i].action).toLower().contains("match")) {
             matchCount++;
         }
     }
@@ -594,7 +597,7 @@ void SyntacticVisualizer::addTableRow(int index) {
     }
 
     // 3. Action Column and Color Logic
-    QString actionStr = QString::fromStdString(step.action);
+    QString actionStr = QString::fromStdString(*step.action);
     QColor rowColor = Qt::black; 
     if (actionStr.toLower().contains("match")) rowColor = QColor(76, 175, 80); // Green
     else if (actionStr.toLower().contains("expand") || actionStr.toLower().contains("push")) 
@@ -0,0 +1,214 @@
+#include <algorithm>
+#include <chrono>
+#include <stdexcept>
+#include "incremental_parse.h"
+
+using namespace std;
+
+
+// Copies nodes [firstNode, endNode) of a tree into a tree of their own over
+// tokens, which start at firstToken of the source tree's tokens. Nodes only
+// refer to nodes and constants created before them, so one pass in order
+// rebuilds them with the same relative indices.
+static void copyStatements(const Ast& from, NodeIndex firstNode, NodeIndex endNode,
+                           uint32_t firstToken, TokenSpan tokens, Ast& to) {
+    to.reset(tokens);
+    auto local = [&](NodeIndex child) { return child == NO_NODE ? NO_NODE : child - firstNode; };
+    for (NodeIndex i = firstNode; i < endNode; i++) {
+        const AstNode& n = from[i];
+        uint32_t token = n.token - firstToken;
+        switch (n.kind) {
+            case AstKind::Number:
+                to.addNumber(token, from.number(n));
+                break;
+            case AstKind::Assign:
+            case AstKind::Print:
+                to.appendStatement(to.add(n.kind, n.op, token, local(n.left), NO_NODE));
+                break;
+            default:
+                to.add(n.kind, n.op, token, local(n.left), local(n.right));
+                break;
+        }
+    }
+}
+
+
+// Makes room for count elements in place of v[first, last), moving the
+// elements after them only once
+template <typename T>
+static void resizeRange(vector<T>& v, size_t first, size_t last, size_t count) {
+    size_t removed = last - first;
+    if (count > removed) {
+        size_t oldSize = v.size();
+        v.resize(oldSize + count - removed);
+        move_backward(v.begin() + last, v.begin() + oldSize, v.end());
+    } else if (count < removed) {
+        move(v.begin() + last, v.end(), v.begin() + first + count);
+        v.resize(v.size() - (removed - count));
+    }
+}
+
+
+size_t IncrementalParser::statementAt(size_t token) const {
+    auto after = upper_bound(entries.begin(), entries.end(), token,
+                             [](size_t t, const Position& p) { return t < p.start; });
+    return after - entries.begin() - 1;
+}
+
+
+ReparseStats IncrementalParser::load(TokenSpan tokens) {
+    auto started = chrono::steady_clock::now();
+    entries.clear();
+    bodies.clear();
+    freeBodies.clear();
+    programLength = 0;
+    diagnosticCount = 0;
+
+    scratch.assign(tokens.begin(), tokens.end());
+    Parser parser(scratch);
+    parser.parse(scratchTree, scratchDiagnostics, boundaries);
+
+    ReparseStats stats;
+    stats.parsedTokens = scratch.size();
+    stats.newStatements = splice(0, 0, scratch.size(), scratchTree.size(), scratch.size(), 0);
+    stats.seconds = chrono::duration<double>(chrono::steady_clock::now() - started).count();
+    return stats;
+}
+
+
+ReparseStats IncrementalParser::edit(size_t firstToken, size_t removedTokens, TokenSpan inserted, ptrdiff_t textShift) {
+    auto started = chrono::steady_clock::now();
+    size_t editEnd = firstToken + removedTokens;
+    if (editEnd > programLength) throw std::runtime_error("Edit lies outside the program");
+
+    auto startOf = [&](size_t entry) -> size_t {
+        return entry < entries.size() ? entries[entry].start : programLength;
+    };
+    auto copyTokens = [&](size_t entry, size_t from, size_t to, ptrdiff_t shift) {
+        const vector<Token>& own = bodies[entries[entry].body]->tokens;
+        for (size_t t = from; t < to; t++) {
+            scratch.push_back(own[t - entries[entry].start]);
+            scratch.back().offset += shift;
+        }
+    };
+
+    // The entry before the edit is parsed again too: its last step looked
+    // at the first token the edit may have changed
+    size_t first = firstToken == 0 || entries.empty() ? 0 : statementAt(firstToken - 1);
+    size_t after = first;
+    while (after < entries.size() && entries[after].start < editEnd) after++;
+
+    // The edited entries with the edit applied, in the new text's offsets
+    scratch.clear();
+    for (size_t i = first; i < after; i++) copyTokens(i, startOf(i), min(startOf(i + 1), firstToken), entries[i].shift);
+    scratch.insert(scratch.end(), inserted.begin(), inserted.end());
+    for (size_t i = first; i < after; i++) copyTokens(i, max(startOf(i), editEnd), startOf(i + 1), entries[i].shift + textShift);
+    size_t regionLength = scratch.size();
+
+    // Followed by as many unchanged entries as it takes to get back in step
+    // with the old parse, doubling on every miss
+    ReparseStats stats;
+    for (size_t context = 1; ; context *= 2) {
+        size_t contextEnd = min(after + context, entries.size());
+        scratch.erase(scratch.begin() + regionLength, scratch.end());
+        for (size_t i = after; i < contextEnd; i++) copyTokens(i, startOf(i), startOf(i + 1), entries[i].shift + textShift);
+
+        Parser parser(scratch);
+        parser.parse(scratchTree, scratchDiagnostics, boundaries);
+        stats.parsedTokens += scratch.size();
+
+        size_t last = entries.size();
+        size_t end = scratch.size();
+        size_t endNode = scratchTree.size();
+        size_t j = after;
+        for (const StatementBoundary& b : boundaries) {
+            while (j < contextEnd && regionLength + startOf(j) - startOf(after) < b.token) j++;
+            if (j < contextEnd && regionLength + startOf(j) - startOf(after) == b.token) {
+                last = j;
+                end = b.token;
+                endNode = b.node;
+                break;
+            }
+        }
+        if (last == entries.size() && contextEnd < entries.size()) continue;
+
+        stats.replacedStatements = last - first;
+        stats.newStatements = splice(first, last, end, endNode,
+                                     static_cast<ptrdiff_t>(inserted.size()) - static_cast<ptrdiff_t>(removedTokens),
+                                     textShift);
+        break;
+    }
+    stats.seconds = chrono::duration<double>(chrono::steady_clock::now() - started).count();
+    return stats;
+}
+
+
+// Replaces entries [first, last) by the entries in scratch[0, end), as cut
+// by the boundaries of the last parse, and moves the entries after them.
+// When last is the end of the program, diagnostics at the end of input go
+// to the last new entry.
+size_t IncrementalParser::splice(size_t first, size_t last, size_t end, size_t endNode,
+                                 ptrdiff_t tokenShift, ptrdiff_t textShift) {
+    cuts.assign(1, StatementBoundary{0, 0});
+    for (const StatementBoundary& b : boundaries) {
+        if (b.token >= end) break;
+        if (b.token > cuts.back().token) cuts.push_back(b);
+    }
+    if (end > 0) cuts.push_back({static_cast<uint32_t>(end), static_cast<NodeIndex>(endNode)});
+    size_t count = cuts.size() - 1;
+
+    size_t base = first < entries.size() ? entries[first].start : programLength;
+    bool toEnd = last == entries.size();
+    for (size_t i = first; i < last; i++) {
+        diagnosticCount -= entries[i].errors;
+        freeBodies.push_back(entries[i].body);
+    }
+    for (size_t i = last; i < entries.size(); i++) {
+        entries[i].start += tokenShift;
+        entries[i].shift += textShift;
+    }
+    programLength += tokenShift;
+    resizeRange(entries, first, last, count);
+
+    size_t d = 0;
+    for (size_t k = 0; k < count; k++) {
+        size_t from = cuts[k].token;
+        size_t to = cuts[k + 1].token;
+
+        if (freeBodies.empty()) {
+            freeBodies.push_back(static_cast<uint32_t>(bodies.size()));
+            bodies.push_back(make_unique<Statement>());
+        }
+        uint32_t body = freeBodies.back();
+        freeBodies.pop_back();
+
+        Statement* entry = bodies[body].get();
+        entry->diagnostics.clear();
+        entry->tokens.assign(scratch.begin() + from, scratch.begin() + to);
+        copyStatements(scratchTree, cuts[k].node, cuts[k + 1].node, cuts[k].token, entry->tokens, entry->tree);
+        while (d < scratchDiagnostics.size() && (scratchDiagnostics[d].tokenIndex < to || (k + 1 == count && toEnd))) {
+            entry->diagnostics.push_back(scratchDiagnostics[d++]);
+            entry->diagnostics.back().tokenIndex -= from;
+        }
+
+        entries[first + k] = {static_cast<uint32_t>(base + from), body, static_cast<uint32_t>(entry->diagnostics.size()), 0};
+        diagnosticCount += entry->diagnostics.size();
+    }
+    return count;
+}
+
+
+void IncrementalParser::diagnostics(const LineIndex& lines, vector<Diagnostic>& found) const {
+    found.clear();
+    if (diagnosticCount == 0) return;
+    for (size_t i = 0; i < entries.size(); i++) {
+        if (entries[i].errors == 0) continue;
+        for (Diagnostic d : bodies[entries[i].body]->diagnostics) {
+            d.tokenIndex += entries[i].start;
+            d.offset += entries[i].shift;
+            d.line = lines.lineAt(d.offset);
+            d.column = lines.columnAt(d.offset);
+            found.push_back(std::move(d));
+        }
+    }
+}
@@ -0,0 +1,96 @@
+#ifndef INCREMENTAL_PARSE_H
+#define INCREMENTAL_PARSE_H
+
+#include <cstddef>
+#include <memory>
+#include <vector>
+#include "syntactic.h"
+
+using namespace std;
+
+struct ReparseStats {
+    size_t parsedTokens = 0;        // tokens run through the Parser, retries included
+    size_t replacedStatements = 0;
+    size_t newStatements = 0;
+    double seconds = 0.0;
+};
+
+// Keeps a program parsed across edits, indexed by statement: every entry
+// holds its tokens, its syntax tree and its diagnostics. An edit is parsed
+// again from the entry before it, only until the new parse passes a
+// statement boundary where the old one started an unchanged entry. From
+// there on both parses are in the same state on the same input, so the
+// entries after it are kept, and the new ones are spliced in between.
+//
+// Entries start at StatementBoundary points. Normally that is one entry
+// per statement; a statement with an error shares its entry with whatever
+// the error recovery skipped after it.
+//
+// The entries together hold what Parser::parse(ast, diagnostics) gives for
+// the whole current program.
+class IncrementalParser {
+public:
+    ReparseStats load(TokenSpan tokens);
+
+    // Replaces tokens [firstToken, firstToken + removedTokens) by inserted,
+    // lexed from the new text. textShift is the change in text length, by
+    // which the offsets of all tokens after the edit move. Throws
+    // runtime_error if the range is outside the program.
+    ReparseStats edit(size_t firstToken, size_t removedTokens, TokenSpan inserted, ptrdiff_t textShift);
+
+    size_t statementCount() const { return entries.size(); }
+    size_t tokenCount() const { return programLength; }
+    size_t statementAt(size_t token) const;          // entry holding the token
+
+    // Token range of an entry, in the current program
+    size_t statementStart(size_t i) const { return entries[i].start; }
+    size_t statementLength(size_t i) const {
+        return (i + 1 < entries.size() ? entries[i + 1].start : programLength) - entries[i].start;
+    }
+
+    // An entry's tree is built over the entry's own tokens, so its token
+    // indices count from statementStart(i). Their offsets are those of the
+    // text the entry was parsed from; add textShift(i) for the current text.
+    const Ast& statementTree(size_t i) const { return bodies[entries[i].body]->tree; }
+    TokenSpan statementTokens(size_t i) const { return bodies[entries[i].body]->tokens; }
+    ptrdiff_t textShift(size_t i) const { return entries[i].shift; }
+
+    bool valid() const { return diagnosticCount == 0; }
+    size_t errorCount() const { return diagnosticCount; }
+
+    // All diagnostics in program order, positioned in the current text
+    void diagnostics(const LineIndex& lines, vector<Diagnostic>& found) const;
+
+private:
+    struct Statement {
+        vector<Token> tokens;
+        Ast tree;
+        vector<Diagnostic> diagnostics;     // tokenIndex counts from the entry's start
+    };
+
+    // The entries in program order. Their bodies stay where they are in a
+    // pool, so an edit only moves these small records for the entries after it.
+    struct Position {
+        uint32_t start;         // first token
+        uint32_t body;          // index in bodies
+        uint32_t errors;        // diagnostics in the entry
+        ptrdiff_t shift;        // text length change since it was parsed
+    };
+
+    vector<Position> entries;
+    vector<unique_ptr<Statement>> bodies;
+    vector<uint32_t> freeBodies;
+    size_t programLength = 0;
+    size_t diagnosticCount = 0;
+
+    // Reused between edits
+    vector<Token> scratch;
+    Ast scratchTree;
+    vector<Diagnostic> scratchDiagnostics;
+    vector<StatementBoundary> boundaries;
+    vector<StatementBoundary> cuts;
+
+    size_t splice(size_t first, size_t last, size_t end, size_t endNode, ptrdiff_t tokenShift, ptrdiff_t textShift);
+};
+
+#endif
@@ -8,12 +8,17 @@
 #include <cctype> // for isspace
 #include <list>   // Used for NFA transitions in the provided code, though your lexical.h uses vector
 #include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
 #include "lexical.h"
+#include "regex_nfa.h"
 
 using namespace std;
 
 
-int nextStateNumber = 0;
+thread_local int nextStateNumber = 0;
 static const char EPSILON = '\0';
 
 
@@ -328,23 +333,448 @@ DFA convertNFAtoDFA(NFA nfa) {
     return { startDFA, dfaStates };
 }
 
-map<string, TokenType> print = {{"print", PRINT}};
-map<string, TokenType> functions = {{"sin", FUNCTION}, {"cos", FUNCTION}, {"tan", FUNCTION}, 
-                                    {"sqrt", FUNCTION}, {"abs", FUNCTION}, {"ceil", FUNCTION}, {"floor", FUNCTION}};
+TokenRules defaultTokenRules() {
+    TokenRules rules;
+    rules.keywords = {{"print", PRINT},
+                      {"sin", FUNCTION}, {"cos", FUNCTION}, {"tan", FUNCTION}, 
+                      {"sqrt", FUNCTION}, {"abs", FUNCTION}, {"ceil", FUNCTION}, {"floor", FUNCTION}};
+    rules.operators = {{'%', MOD}, {'+', PLUS}, {'-', MINUS}, {'*', MULTIPLY},
+                       {'/', DIVIDE}, {'=', ASSIGN}, {'(', LPAREN}, {')', RPAREN}};
+    return rules;
+}
+
+
+TokenType tokenTypeFromName(const string& name) {
+    for (int t = IDENTIFIER; t < UNKNOWN; t++) {
+        if (getTokenName(static_cast<TokenType>(t)) == name) return static_cast<TokenType>(t);
+    }
+    return UNKNOWN;
+}
+
+
+// Spec format, one rule per line, '#' starts a comment:
+//   keyword  <lexeme> <TOKEN>     e.g.  keyword print PRINT
+//   function <name>               same as: keyword <name> FUNCTION
+//   operator <char>   <TOKEN>     e.g.  operator + PLUS
+//   token    <TOKEN>  <regex>     e.g.  token NUMBER 0x[0-9a-fA-F]+
+// TOKEN is a name as printed by getTokenName. A token regex runs to the end
+// of the line and may itself contain '#'.
+TokenRules parseTokenRules(const string& text) {
+    TokenRules rules;
+    istringstream in(text);
+    string rawLine;
+    int lineNo = 0;
+
+    while (getline(in, rawLine)) {
+        lineNo++;
+        if (!rawLine.empty() && rawLine.back() == '\r') rawLine.pop_back();
+
+        auto fail = [&](const string& why) {
+            throw std::runtime_error("Token rules: " + why + " at line " + std::to_string(lineNo));
+        };
+
+        istringstream head(rawLine);
+        string kind, lexeme, typeName, extra;
+        if ((head >> kind) && kind == "token") {
+            if (!(head >> typeName)) fail("expected 'token <TOKEN> <regex>'");
+            TokenType type = tokenTypeFromName(typeName);
+            if (type == UNKNOWN || type == WHITESPACE) fail("unknown token type '" + typeName + "'");
+
+            string pattern;
+            getline(head >> ws, pattern);
+            while (!pattern.empty() && isspace(static_cast<unsigned char>(pattern.back()))) pattern.pop_back();
+            if (pattern.empty()) fail("missing regex");
+            rules.patterns.push_back({pattern, type});
+            continue;
+        }
+
+        size_t hash = rawLine.find('#');
+        if (hash != string::npos) rawLine.erase(hash);
+
+        istringstream fields(rawLine);
+        if (!(fields >> kind)) continue;
+
+        if (kind == "function") {
+            if (!(fields >> lexeme) || (fields >> extra)) fail("expected 'function <name>'");
+            rules.keywords[lexeme] = FUNCTION;
+            continue;
+        }
+        if (kind != "keyword" && kind != "operator") fail("unknown rule '" + kind + "'");
+        if (!(fields >> lexeme >> typeName) || (fields >> extra)) fail("expected '" + kind + " <lexeme> <TOKEN>'");
+
+        TokenType type = tokenTypeFromName(typeName);
+        if (type == UNKNOWN || type == WHITESPACE) fail("unknown token type '" + typeName + "'");
+
+        if (kind == "keyword") {
+            rules.keywords[lexeme] = type;
+        } else {
+            if (lexeme.size() != 1) fail("operator must be a single character");
+            rules.operators.push_back({lexeme[0], type});
+        }
+    }
+    return rules;
+}
+
+
+TokenRules loadTokenRules(const string& path) {
+    ifstream file(path, ios::binary);
+    if (!file) throw std::runtime_error("Token rules: cannot open " + path);
+    stringstream buffer;
+    buffer << file.rdbuf();
+    return parseTokenRules(buffer.str());
+}
+
+
+// NFA states are only needed during subset construction
+static void deleteNFA(NFAState* start) {
+    set<NFAState*> seen = { start };
+    stack<NFAState*> pending;
+    pending.push(start);
+
+    while (!pending.empty()) {
+        NFAState* s = pending.top();
+        pending.pop();
+        auto visit = [&](NFAState* t) {
+            if (seen.insert(t).second) pending.push(t);
+        };
+        for (NFAState* t : s->epsilon) visit(t);
+        for (auto& [ch, targets] : s->transitions) {
+            for (NFAState* t : targets) visit(t);
+        }
+    }
+    for (NFAState* s : seen) delete s;
+}
+
+
+CompiledLexer::~CompiledLexer() {
+    for (DFAState* s : dfa.allStates) delete s;
+}
+
+
+// Rows are numbered with uint16_t
+static void checkRowCount(size_t rows) {
+    if (rows > 0xFFFF) {
+        throw std::runtime_error("DFA has " + to_string(rows) + " states; the flat table holds at most 65535");
+    }
+}
+
 
-                                    
+DFATable compileDFATable(const DFA& dfa) {
+    DFATable table;
+    const size_t rows = dfa.allStates.size();
+    checkRowCount(rows);
+    map<DFAState*, uint16_t> rowOf;
+    for (size_t r = 0; r < rows; r++) rowOf[dfa.allStates[r]] = static_cast<uint16_t>(r);
 
+    table.start = rowOf[dfa.start];
+    table.dead = static_cast<uint16_t>(rows - 1);   // convertNFAtoDFA appends the sink last
+    for (DFAState* s : dfa.allStates) {
+        table.accepting.push_back(s->isAccepting ? s->tokenType : UNKNOWN);
+        table.stateIds.push_back(s->id);
+    }
+
+    // Bytes whose target is the same in every state share a column. Bytes
+    // outside the alphabet go to the sink, which the scanner treats as a stop.
+    map<vector<uint16_t>, uint8_t> classOf;
+    vector<vector<uint16_t>> columns;
+    for (int b = 0; b < 256; b++) {
+        vector<uint16_t> column(rows, table.dead);
+        for (size_t r = 0; r < rows; r++) {
+            auto it = dfa.allStates[r]->transitions.find(static_cast<char>(b));
+            if (it != dfa.allStates[r]->transitions.end()) column[r] = rowOf[it->second];
+        }
+        auto found = classOf.find(column);
+        if (found == classOf.end()) {
+            found = classOf.emplace(column, static_cast<uint8_t>(columns.size())).first;
+            columns.push_back(column);
+        }
+        table.byteClass[b] = found->second;
+    }
+
+    table.classCount = static_cast<int>(columns.size());
+    table.next.resize(rows * table.classCount);
+    for (size_t r = 0; r < rows; r++) {
+        for (int c = 0; c < table.classCount; c++) {
+            table.next[r * table.classCount + c] = columns[c][r];
+        }
+    }
+    return table;
+}
+
+
+DFAProfile profileDFATable(const DFATable& table, const vector<string>& corpus) {
+    DFAProfile profile;
+    profile.rowVisits.assign(table.rowCount(), 0);
+    profile.transitionCounts.assign(table.next.size(), 0);
+
+    // Same walk as the table scanner, minus keyword and token bookkeeping
+    for (const string& text : corpus) {
+        size_t pos = 0;
+        while (pos < text.size()) {
+            while (pos < text.size() && isspace(static_cast<unsigned char>(text[pos]))) pos++;
+            if (pos >= text.size()) break;
+
+            uint16_t row = table.start;
+            size_t i = pos, lastAccept = pos;
+            profile.rowVisits[row]++;
+            while (i < text.size()) {
+                size_t cell = row * table.classCount + table.byteClass[static_cast<unsigned char>(text[i])];
+                profile.transitionCounts[cell]++;
+                row = table.next[cell];
+                if (row == table.dead) break;
+                profile.rowVisits[row]++;
+                i++;
+                if (table.accepting[row] != UNKNOWN) lastAccept = i;
+            }
+            pos = lastAccept > pos ? lastAccept : pos + 1;
+        }
+    }
+    return profile;
+}
+
+
+DFATable relayoutDFATable(const DFATable& table, const DFAProfile& profile) {
+    const size_t rows = table.rowCount();
+    checkRowCount(rows);
+    const size_t classes = static_cast<size_t>(table.classCount);
+
+    // Chains along the hottest transitions: start from the hottest row not
+    // yet placed, then keep placing the unplaced row it most often moves
+    // to, so a scan mostly steps to the row right after the current one.
+    // Never-visited rows and the sink go to the end.
+    vector<uint16_t> order;
+    vector<uint8_t> placed(rows, 0);
+    placed[table.dead] = 1;
+    vector<uint16_t> byVisits;
+    for (size_t r = 0; r < rows; r++) {
+        if (r != table.dead) byVisits.push_back(static_cast<uint16_t>(r));
+    }
+    stable_sort(byVisits.begin(), byVisits.end(), [&](uint16_t a, uint16_t b) {
+        return profile.rowVisits[a] > profile.rowVisits[b];
+    });
+
+    vector<uint64_t> toward(rows, 0);
+    for (uint16_t head : byVisits) {
+        if (placed[head]) continue;
+        if (profile.rowVisits[head] == 0) break;
+        for (uint16_t row = head; ; ) {
+            placed[row] = 1;
+            order.push_back(row);
+
+            // Transitions of one row can share a target under several classes
+            fill(toward.begin(), toward.end(), 0);
+            for (size_t c = 0; c < classes; c++) {
+                size_t cell = row * classes + c;
+                toward[table.next[cell]] += profile.transitionCounts[cell];
+            }
+            uint16_t hottest = table.dead;
+            for (size_t c = 0; c < classes; c++) {
+                uint16_t target = table.next[row * classes + c];
+                if (!placed[target] && toward[target] > 0 &&
+                    (hottest == table.dead || toward[target] > toward[hottest])) {
+                    hottest = target;
+                }
+            }
+            if (hottest == table.dead) break;
+            row = hottest;
+        }
+    }
+    for (uint16_t r : byVisits) {
+        if (!placed[r]) order.push_back(r);
+    }
+    order.push_back(table.dead);
+
+    vector<uint16_t> newRow(rows);
+    for (size_t r = 0; r < rows; r++) newRow[order[r]] = static_cast<uint16_t>(r);
+
+    DFATable out;
+    out.byteClass = table.byteClass;
+    out.classCount = table.classCount;
+    out.start = newRow[table.start];
+    out.dead = newRow[table.dead];
+    out.next.resize(table.next.size());
+    for (size_t r = 0; r < rows; r++) {
+        uint16_t old = order[r];
+        out.accepting.push_back(table.accepting[old]);
+        out.stateIds.push_back(table.stateIds[old]);
+        for (int c = 0; c < table.classCount; c++) {
+            out.next[r * table.classCount + c] = newRow[table.next[old * table.classCount + c]];
+        }
+    }
+    return out;
+}
+
+
+// Hand-built NFA states are heap-allocated one by one; this frees them, and
+// the state combining all NFAs, however buildLexer is left
+struct BuildNFAs {
+    vector<NFA> handBuilt;
+    NFAState* masterStart = nullptr;
+
+    ~BuildNFAs() {
+        for (const NFA& nfa : handBuilt) deleteNFA(nfa.start);
+        delete masterStart;
+    }
+};
+
+
+shared_ptr<const CompiledLexer> buildLexer(const TokenRules& rules, const vector<string>& profileCorpus) {
+    BuildNFAs owned;
+    vector<NFA>& handBuilt = owned.handBuilt;
+    handBuilt.push_back(createIdentifierNFA());
+    handBuilt.push_back(createNumberNFA());
+    for (const auto& [c, type] : rules.operators) {
+        handBuilt.push_back(createSingleCharNFA(c, type));
+    }
 
-ScanResult scanNextToken(const DFA& dfa, const string& input, size_t pos, int& line) {
+    // Regex NFAs live in the arena; it is dropped once the DFA exists
+    AutomatonArena arena;
+    vector<NFA> nfas = handBuilt;
+    for (const auto& [pattern, type] : rules.patterns) {
+        nfas.push_back(compileRegex(pattern, type, arena));
+    }
+
+    NFA masterNFA = combineNFAs(nfas);
+    owned.masterStart = masterNFA.start;
+
+    auto lexer = make_shared<CompiledLexer>();
+    lexer->dfa = convertNFAtoDFA(masterNFA);
+    lexer->table = compileDFATable(lexer->dfa);
+    if (!profileCorpus.empty()) {
+        lexer->table = relayoutDFATable(lexer->table, profileDFATable(lexer->table, profileCorpus));
+    }
+    lexer->keywords = rules.keywords;
+    return lexer;
+}
+
+
+static const map<string, TokenType>& defaultKeywords() {
+    static const map<string, TokenType> keywords = defaultTokenRules().keywords;
+    return keywords;
+}
+
+
+static ScanResult scanWithKeywords(const DFA& dfa, const map<string, TokenType>& keywords,
+                                   const string& input, size_t pos);
+
+
+ScanResult scanNextToken(const DFA& dfa, const string& input, size_t pos) {
+    return scanWithKeywords(dfa, defaultKeywords(), input, pos);
+}
+
+
+ScanResult scanNextToken(const CompiledLexer& lexer, const string& input, size_t pos) {
+    return scanWithKeywords(lexer.dfa, lexer.keywords, input, pos);
+}
+
+
+ScanResult scanNextToken(const DFATable& table, const map<string, TokenType>& keywords,
+                         const string& input, size_t pos) {
     ScanResult result;
     const size_t n = input.size();
 
-    //Skip whitespace
     size_t scanStartPos = pos;
     while (scanStartPos < n && isspace(static_cast<unsigned char>(input[scanStartPos]))) {
-        if (input[scanStartPos] == '\n') {
-            line++;
+        scanStartPos++;
+    }
+    if (scanStartPos >= n) {
+        result.newPosition = n;
+        return result;
+    }
+
+    const uint16_t* next = table.next.data();
+    const uint8_t* byteClass = table.byteClass.data();
+    const size_t classCount = static_cast<size_t>(table.classCount);
+
+    uint16_t row = table.start;
+    size_t lastAccept = scanStartPos;
+    TokenType lastToken = table.accepting[row];
+
+    // Once in the sink no longer match is possible, so stop there
+    for (size_t i = scanStartPos; i < n; ) {
+        row = next[row * classCount + byteClass[static_cast<unsigned char>(input[i])]];
+        if (row == table.dead) break;
+        i++;
+        if (table.accepting[row] != UNKNOWN) {
+            lastAccept = i;
+            lastToken = table.accepting[row];
         }
+    }
+
+    if (lastToken == UNKNOWN) {
+        result.newPosition = scanStartPos + 1;
+        return result;
+    }
+
+    string lexeme = input.substr(scanStartPos, lastAccept - scanStartPos);
+    if (lastToken == IDENTIFIER) {
+        auto it_kw = keywords.find(lexeme);
+        if (it_kw != keywords.end()) lastToken = it_kw->second;
+    }
+
+    result.foundToken = true;
+    result.token = Token{lastToken, lexeme, scanStartPos};
+    result.newPosition = lastAccept;
+    return result;
+}
+
+
+bool TokenStream::next(Token& token) {
+    while (pos < text.size()) {
+        size_t from = pos;
+        ScanResult r = scanNextToken(lexer.table, lexer.keywords, text, pos);
+        pos = r.newPosition;
+        if (r.foundToken) {
+            token = std::move(r.token);
+        } else if (pos > from && !isspace(static_cast<unsigned char>(text[pos - 1]))) {
+            token = Token{UNKNOWN, text.substr(pos - 1, 1), pos - 1};
+        } else {
+            continue;
+        }
+        lastEnd = token.offset + token.lexeme.size();
+        return true;
+    }
+    return false;
+}
+
+
+
+
+LineIndex::LineIndex(const string& text) : lineStarts{0} {
+    const char* base = text.data();
+    const char* end = base + text.size();
+    const char* p = base;
+
+    // memchr is vectorized by every libc we ship on, so this is one fast pass
+    while (p < end) {
+        const void* nl = memchr(p, '\n', static_cast<size_t>(end - p));
+        if (!nl) break;
+        p = static_cast<const char*>(nl) + 1;
+        lineStarts.push_back(static_cast<size_t>(p - base));
+    }
+}
+
+
+int LineIndex::lineAt(size_t offset) const {
+    auto it = upper_bound(lineStarts.begin(), lineStarts.end(), offset);
+    return static_cast<int>(it - lineStarts.begin());
+}
+
+
+int LineIndex::columnAt(size_t offset) const {
+    int line = lineAt(offset);
+    return static_cast<int>(offset - lineStarts[line - 1]) + 1;
+}
+
+
+static ScanResult scanWithKeywords(const DFA& dfa, const map<string, TokenType>& keywords,
+                                   const string& input, size_t pos) {
+    ScanResult result;
+    const size_t n = input.size();
+
+    //Skip whitespace
+    size_t scanStartPos = pos;
+    while (scanStartPos < n && isspace(static_cast<unsigned char>(input[scanStartPos]))) {
         scanStartPos++;
     }
     
@@ -399,29 +829,19 @@ ScanResult scanNextToken(const DFA& dfa, const string& input, size_t pos, int& l
 
         // Check if the lexeme matches a keyword
         if (lastToken == IDENTIFIER) {
-            auto it_kw = print.find(lexeme);
-            if (it_kw != print.end()) {
+            auto it_kw = keywords.find(lexeme);
+            if (it_kw != keywords.end()) {
                 lastToken = it_kw->second; 
-            } else {
-                auto it_func = functions.find(lexeme);
-                if (it_func != functions.end()) {
-                    lastToken = it_func->second;
-                }
             }
         }
 
         result.foundToken = true;
-        result.token = Token{lastToken, lexeme, line};
+        result.token = Token{lastToken, lexeme, scanStartPos};
         result.newPosition = lastAccept;
         result.traversalPath = acceptedPath; 
-
-        for (char c : lexeme) {
-            if (c == '\n') line++;
-        }
     } else {
         result.foundToken = false;
         result.newPosition = scanStartPos + 1; 
-        if (scanStartPos < n && input[scanStartPos] == '\n') line++;
     }
 
     return result;
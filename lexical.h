@@ -5,6 +5,11 @@
 #include <vector>
 #include <map>
 #include <set>
+#include <array>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <utility>
 #include <cstddef>
 
 using namespace std;
@@ -31,13 +36,51 @@ struct Token {
     TokenType type;
     string value;
     string lexeme;
-    int line;
+    size_t offset;   // byte offset of the lexeme in the source, see LineIndex
 
-    Token(TokenType t, const std::string& v, int l)
-        : type(t), value(v), lexeme(v), line(l) {}
+    Token(TokenType t, const std::string& v, size_t o)
+        : type(t), value(v), lexeme(v), offset(o) {}
 };
 
 
+// Non-owning view of a token buffer, so tokens can be handed on without
+// copying. The buffer must outlive the span and must not grow meanwhile.
+struct TokenSpan {
+    const Token* tokens = nullptr;
+    size_t count = 0;
+
+    TokenSpan() = default;
+    TokenSpan(const Token* t, size_t n) : tokens(t), count(n) {}
+    TokenSpan(const vector<Token>& v) : tokens(v.data()), count(v.size()) {}
+
+    const Token* begin() const { return tokens; }
+    const Token* end() const { return tokens + count; }
+    size_t size() const { return count; }
+    bool empty() const { return count == 0; }
+    const Token& operator[](size_t i) const { return tokens[i]; }
+    const Token& back() const { return tokens[count - 1]; }
+};
+
+
+// Line-start table for one source buffer. Built in a single memchr pass over
+// the newlines, so the scanner never counts lines; line and column of any
+// byte offset are resolved on demand with a binary search.
+class LineIndex {
+public:
+    LineIndex() : lineStarts{0} {}
+    explicit LineIndex(const string& text);
+
+    int lineAt(size_t offset) const;     // 1-based
+    int columnAt(size_t offset) const;   // 1-based, in bytes
+    size_t lineCount() const { return lineStarts.size(); }
+
+private:
+    vector<size_t> lineStarts;
+};
+
+
+extern thread_local int nextStateNumber;
+
 // NFA and DFA structures
 struct NFAState {
     int id;
@@ -58,6 +101,21 @@ struct NFA {
 };
 
 
+// Owns NFA states in bulk; everything allocated here is freed with the arena.
+// Pointers stay valid because deque never relocates its elements.
+class AutomatonArena {
+public:
+    NFAState* newState(bool accepting = false, TokenType type = UNKNOWN) {
+        states.emplace_back(nextStateNumber++, accepting, type);
+        return &states.back();
+    }
+    size_t size() const { return states.size(); }
+
+private:
+    deque<NFAState> states;
+};
+
+
 
 struct DFAState {
     int id;
@@ -101,14 +159,110 @@ struct TransitionTrace {
 
 struct ScanResult {
     bool foundToken = false;
-    Token token = {UNKNOWN, "", 1};
+    Token token = {UNKNOWN, "", 0};
     size_t newPosition = 0;
 
     vector<TransitionTrace> traversalPath;
 };
 
-ScanResult scanNextToken(const DFA& dfa, const string& input, size_t pos, int& line);
-extern int nextStateNumber;
+ScanResult scanNextToken(const DFA& dfa, const string& input, size_t pos);
+
+
+// Token rules that are data rather than code: keyword lexemes the identifier
+// DFA hands back as another token type, single-character operators and
+// regex patterns (see regex_nfa.h). Identifiers and numbers stay hand-built
+// NFAs so the default DFA keeps its state numbering.
+struct TokenRules {
+    map<string, TokenType> keywords;
+    vector<pair<char, TokenType>> operators;
+    vector<pair<string, TokenType>> patterns;
+};
+
+TokenRules defaultTokenRules();
+TokenRules parseTokenRules(const string& text);
+TokenRules loadTokenRules(const string& path);
+TokenType tokenTypeFromName(const string& name);
+
+// Flat form of a DFA for the tokenization hot path. Input bytes are folded
+// into equivalence classes first, so a row holds one entry per class rather
+// than per byte and several hot rows fit in one cache line. Rows start out in
+// allStates order (BFS discovery, dead state last); relayoutDFATable can
+// reorder them by a recorded profile.
+struct DFATable {
+    array<uint8_t, 256> byteClass{};
+    int classCount = 0;
+    vector<uint16_t> next;           // next[row * classCount + class]
+    vector<TokenType> accepting;     // UNKNOWN for non-accepting rows
+    vector<int> stateIds;            // DFAState::id of each row
+    uint16_t start = 0;
+    uint16_t dead = 0;
+
+    size_t rowCount() const { return accepting.size(); }
+};
+
+// How often each row and each (row, class) transition fired on a corpus
+struct DFAProfile {
+    vector<uint64_t> rowVisits;
+    vector<uint64_t> transitionCounts;
+};
+
+// Both throw runtime_error for more than 65535 rows, which uint16_t row
+// numbers cannot hold. relayoutDFATable puts each hot row right after the
+// row whose hottest transition leads to it.
+DFATable compileDFATable(const DFA& dfa);
+DFAProfile profileDFATable(const DFATable& table, const vector<string>& corpus);
+DFATable relayoutDFATable(const DFATable& table, const DFAProfile& profile);
+
+// A DFA built from one TokenRules, together with its keyword table. It owns
+// its states, so it can be shared read-only and freed by the last user.
+struct CompiledLexer {
+    DFA dfa;
+    DFATable table;
+    map<string, TokenType> keywords;
+
+    CompiledLexer() = default;
+    CompiledLexer(const CompiledLexer&) = delete;
+    CompiledLexer& operator=(const CompiledLexer&) = delete;
+    ~CompiledLexer();
+};
+
+// With a profile corpus the table rows are laid out hottest-first
+shared_ptr<const CompiledLexer> buildLexer(const TokenRules& rules,
+                                           const vector<string>& profileCorpus = {});
+ScanResult scanNextToken(const CompiledLexer& lexer, const string& input, size_t pos);
+
+// Table-driven scan without a traversal path, for headless tokenization
+ScanResult scanNextToken(const DFATable& table, const map<string, TokenType>& keywords,
+                         const string& input, size_t pos);
+
+// Where a streaming Parser gets its tokens from (see Parser(TokenSource&))
+class TokenSource {
+public:
+    virtual ~TokenSource() = default;
+
+    virtual bool next(Token& token) = 0;          // false once the input is used up
+    virtual void rewind() = 0;                    // back to the first token
+    virtual size_t endOffset() const = 0;         // just past the last token so far
+};
+
+// Hands out the tokens of a text one at a time, for consumers that never
+// need them all at once. Characters no rule matches come out as UNKNOWN
+// tokens, as in TokenizeService. The lexer and the text must outlive the
+// stream.
+class TokenStream : public TokenSource {
+public:
+    TokenStream(const CompiledLexer& lexer, const string& text) : lexer(lexer), text(text) {}
+
+    bool next(Token& token) override;
+    void rewind() override { pos = 0; lastEnd = 0; }
+    size_t endOffset() const override { return lastEnd; }
+
+private:
+    const CompiledLexer& lexer;
+    const string& text;
+    size_t pos = 0;
+    size_t lastEnd = 0;
+};
 
 
 
@@ -0,0 +1,284 @@
+#include <cstdlib>
+#include <stdexcept>
+#include "lr_parse.h"
+
+using namespace std;
+
+// Trace labels that are not tied to a production or terminal
+static const string PUSH_END_LABEL = "push $";
+static const string ACCEPT_LABEL = "ACCEPTED";
+static const string ERROR_LABEL = "ERROR";
+
+// Operands each action takes from its production's nonterminals
+static const int ACTION_OPERANDS[] = { 0, 0, 1, 2, 1, 1 };
+
+static size_t endOfInputOffset(TokenSpan tokens) {
+    return tokens.empty() ? 0 : tokens.back().offset + tokens.back().lexeme.size();
+}
+
+
+struct GeneratedLRGrammar {
+    Grammar grammar;
+    LRTable table;
+    vector<LRReduction> reductions;
+    vector<string> shiftLabels;         // "shift a", per terminal
+    vector<string> reduceLabels;        // "Reduce A → α", per production
+    array<Symbol, UNKNOWN + 1> tokenTerminals;
+};
+
+// The grammar and its table are generated once per process
+static const GeneratedLRGrammar& lrGrammar() {
+    static const GeneratedLRGrammar generated = [] {
+        GeneratedLRGrammar lr;
+        lr.grammar = defaultLRGrammar();
+        const Grammar& g = lr.grammar;
+        lr.table = buildLALRTable(g);
+        if (!lr.table.conflicts.empty()) {
+            throw std::runtime_error("Grammar is not LALR(1): " + describeConflict(g, lr.table.conflicts.front()));
+        }
+
+        lr.tokenTerminals.fill(NO_SYMBOL);
+        for (Symbol t = 0; t < g.terminalCount; t++) {
+            lr.shiftLabels.push_back("shift " + g.symbolNames[t]);
+            if (t == g.endMarker) continue;
+            TokenType type;
+            if (!terminalTokenType(g.symbolNames[t], type)) {
+                throw std::runtime_error("Grammar: no token type for terminal '" + g.symbolNames[t] + "'");
+            }
+            lr.tokenTerminals[type] = t;
+        }
+
+        for (size_t i = 0; i < g.productions.size(); i++) {
+            const GrammarProduction& p = g.productions[i];
+            if (p.rhs.size() > 127) throw std::runtime_error("Grammar: production too long for LRParser: " + g.productionText(i));
+            LRReduction r = { static_cast<uint16_t>(p.rhs.size()), p.lhs, -1, -1, -1, -1 };
+            int operands = 0;
+            for (size_t k = 0; k < p.rhs.size(); k++) {
+                if (g.isTerminal(p.rhs[k])) {
+                    if (r.token < 0) r.token = static_cast<int8_t>(k);
+                } else {
+                    if (r.left < 0) r.left = static_cast<int8_t>(k);
+                    else if (r.right < 0) r.right = static_cast<int8_t>(k);
+                    operands++;
+                }
+            }
+
+            // An action can only run at a reduction, i.e. at the very end
+            for (size_t k = 0; k < p.items.size(); k++) {
+                if (p.items[k].front() != '{') continue;
+                AstAction action;
+                if (!astActionNamed(p.items[k], action)) throw std::runtime_error("Grammar: unknown action " + p.items[k]);
+                if (k + 1 != p.items.size()) {
+                    throw std::runtime_error("Grammar: " + p.items[k] + " must end its production for LRParser: " + g.productionText(i));
+                }
+                if (r.token < 0 || operands < ACTION_OPERANDS[action]) {
+                    throw std::runtime_error("Grammar: " + p.items[k] + " lacks a token or operand in " + g.productionText(i));
+                }
+                r.action = static_cast<int8_t>(action);
+            }
+            lr.reductions.push_back(r);
+            lr.reduceLabels.push_back("Reduce " + g.productionText(i));
+        }
+        return lr;
+    }();
+    return generated;
+}
+
+
+LRParser::LRParser(TokenSpan t, const LineIndex& l)
+    : tokens(t), eof(UNKNOWN, "$", endOfInputOffset(t)), lines(l) {
+    const GeneratedLRGrammar& lr = lrGrammar();
+    actions = lr.table.actions.data();
+    gotos = lr.table.gotos.data();
+    reductions = lr.reductions.data();
+    terminalCount = lr.table.terminalCount;
+    nonterminalCount = lr.table.nonterminalCount;
+    endMarker = lr.grammar.endMarker;
+    tokenTerminals = lr.tokenTerminals;
+}
+
+
+const vector<string>& LRParser::getSymbolNames() const { return lrGrammar().grammar.symbolNames; }
+const vector<string>& LRParser::getProductionLabels() const { return lrGrammar().reduceLabels; }
+size_t LRParser::stateCount() const { return lrGrammar().table.stateCount; }
+
+
+void LRParser::validate() {
+    run<UntracedParse>();
+}
+
+
+void LRParser::parse(Ast& tree) {
+    tree.reset(tokens);
+    ast = &tree;
+    try {
+        run<AstParse>();
+    } catch (...) {
+        ast = nullptr;
+        throw;
+    }
+    ast = nullptr;
+}
+
+
+void LRParser::parse(TraceSink& traceSink) {
+    sink = &traceSink;
+    recycleStackNodes = !traceSink.retainsStack();
+    try {
+        run<TracedParse>();
+    } catch (const std::runtime_error& e) {
+        sink->onError({traceTop, &tokenAt(pos), &ERROR_LABEL, PDAOp::Error, 0, static_cast<uint32_t>(pos)}, e.what());
+        sink = nullptr;
+        throw;
+    }
+    sink = nullptr;
+}
+
+
+template <typename TracePolicy>
+void LRParser::run() {
+    constexpr bool traced = TracePolicy::records;
+    const GeneratedLRGrammar& lr = lrGrammar();
+    const vector<string>& names = lr.grammar.symbolNames;
+    values.clear();
+    stackArena.clear();
+    traceTop = nullptr;
+    pos = 0;
+
+    // The state stack is indexed directly; it only grows on a shift
+    if (states.size() < 64) states.resize(64);
+    uint32_t* stateStack = states.data();
+    size_t depth = 1;
+    stateStack[0] = 0;
+    if constexpr (traced) {
+        traceTop = stackArena.push(nullptr, &names[endMarker]);
+        sink->onStep({traceTop, &tokenAt(0), &PUSH_END_LABEL, PDAOp::Push, endMarker, 0});
+    }
+
+    Symbol lookahead = lookaheadAt(0);
+    while (true) {
+        int32_t action = actions[stateStack[depth - 1] * terminalCount + lookahead];
+
+        if (action > 0) {
+            if (depth == states.size()) {
+                states.resize(2 * depth);
+                stateStack = states.data();
+            }
+            stateStack[depth++] = static_cast<uint32_t>(action - 1);
+            if constexpr (TracePolicy::buildsAst) values.push_back(static_cast<NodeIndex>(pos));
+            if constexpr (traced) {
+                traceTop = stackArena.push(traceTop, &names[lookahead]);
+                if (recycleStackNodes && stackArena.size() > 2 * depth + 4096) compactTraceStack();
+                sink->onStep({traceTop, &tokenAt(pos), &lr.shiftLabels[lookahead],
+                              PDAOp::Push, lookahead, static_cast<uint32_t>(pos)});
+            }
+            lookahead = lookaheadAt(++pos);
+            continue;
+        }
+
+        if (action == LR_ACCEPT) {
+            if constexpr (traced) {
+                sink->onStep({traceTop, &tokenAt(pos), &ACCEPT_LABEL, PDAOp::Accept, 0, static_cast<uint32_t>(pos)});
+            }
+            return;
+        }
+        if (action == LR_ERROR) {
+            throwSyntaxError("Syntax Error at " + names[lookahead] + " at " + describePosition(tokenAt(pos).offset));
+        }
+
+        // Pop the right-hand side, then go to the state for its left-hand
+        // side from the one that is uncovered
+        size_t production = static_cast<size_t>(-action - 1);
+        const LRReduction& r = reductions[production];
+        if constexpr (TracePolicy::buildsAst) reduce(r);
+        depth -= r.length;
+        uint32_t uncovered = stateStack[depth - 1];
+        stateStack[depth++] = static_cast<uint32_t>(gotos[uncovered * nonterminalCount + r.lhs - terminalCount]);
+
+        if constexpr (traced) {
+            for (size_t k = 0; k < r.length; k++) traceTop = traceTop->below;
+            traceTop = stackArena.push(traceTop, &names[r.lhs]);
+            if (recycleStackNodes && stackArena.size() > 2 * depth + 4096) compactTraceStack();
+            sink->onStep({traceTop, &tokenAt(pos), &lr.reduceLabels[production],
+                          PDAOp::Reduce, static_cast<uint16_t>(production), static_cast<uint32_t>(pos)});
+        }
+    }
+}
+
+
+// Nodes are created exactly when the PDA would create them: an operand once
+// it is complete, an operator once its right operand is
+void LRParser::reduce(const LRReduction& r) {
+    size_t first = values.size() - r.length;
+    const NodeIndex* rhs = values.data() + first;
+    NodeIndex node = r.left >= 0 ? rhs[r.left] : NO_NODE;
+
+    if (r.action >= 0) {
+        uint32_t token = rhs[r.token];
+        switch (static_cast<AstAction>(r.action)) {
+            case ActNumber:
+                node = ast->addNumber(token, strtod(tokens[token].value.c_str(), nullptr));
+                break;
+            case ActVariable:
+                node = ast->add(AstKind::Variable, 0, token, NO_NODE, NO_NODE);
+                break;
+            case ActCall:
+                node = ast->add(AstKind::Call, 0, token, node, NO_NODE);
+                break;
+            case ActBinary:
+                node = ast->add(AstKind::Binary, tokens[token].value[0], token, node, rhs[r.right]);
+                break;
+            case ActAssign:
+            case ActPrint: {
+                AstKind kind = r.action == ActAssign ? AstKind::Assign : AstKind::Print;
+                ast->appendStatement(ast->add(kind, 0, token, node, NO_NODE));
+                node = NO_NODE;
+                break;
+            }
+        }
+    }
+    values.resize(first);
+    values.push_back(node);
+}
+
+
+Symbol LRParser::lookaheadAt(size_t i) const {
+    if (i >= tokens.size()) return endMarker;
+    const Token& t = tokens[i];
+    if (t.type != UNKNOWN) {
+        Symbol terminal = tokenTerminals[t.type];
+        if (terminal == NO_SYMBOL) throwSyntaxError("Syntax Error at " + t.value + " at " + describePosition(t.offset));
+        return terminal;
+    }
+    if (t.value == "$") return endMarker;
+    throwSyntaxError("Syntax Error: Unknown token '" + t.value + "' at " + describePosition(t.offset));
+}
+
+
+// Errors are worded the way Parser words them, so switching engines does not
+// change what the user sees. Both parsers stop at the first token that no
+// program continues with, so Parser fails at the same token; running it is
+// paid only once the input is known to be wrong. `fallback` is only thrown
+// if Parser accepts after all.
+void LRParser::throwSyntaxError(const string& fallback) const {
+    Parser(tokens, lines).validate();
+    throw std::runtime_error(fallback);
+}
+
+
+string LRParser::describePosition(size_t offset) const {
+    return "line " + std::to_string(lines.lineAt(offset)) +
+           ", column " + std::to_string(lines.columnAt(offset));
+}
+
+
+// Nobody holds on to old steps, so only the live stack needs to survive
+void LRParser::compactTraceStack() {
+    vector<const string*> live;
+    for (const StackNode* n = traceTop; n; n = n->below) live.push_back(n->symbol);
+
+    StackArena fresh;
+    traceTop = nullptr;
+    for (auto it = live.rbegin(); it != live.rend(); ++it) traceTop = fresh.push(traceTop, *it);
+    swap(stackArena, fresh);
+}
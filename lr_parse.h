@@ -0,0 +1,94 @@
+#ifndef LR_PARSE_H
+#define LR_PARSE_H
+
+#include <array>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "ast.h"
+#include "grammar.h"
+#include "lexical.h"
+#include "pda_tracer.h"
+#include "syntactic.h"
+
+using namespace std;
+
+// What reducing by a production does, precomputed from the grammar
+struct LRReduction {
+    uint16_t length;        // right-hand side symbols to pop
+    Symbol lhs;
+    int8_t action;          // AstAction, or -1 to pass the operand through
+    int8_t token;           // rhs index of the terminal the node is named after
+    int8_t left;            // rhs indices of the first two nonterminals, or -1
+    int8_t right;
+};
+
+// Shift-reduce parser driven by an LALR(1) table generated from the
+// left-recursive calculator grammar (defaultLRGrammar). It accepts the same
+// programs as Parser and builds the same trees node for node: every action
+// ends its production and runs when the production is reduced, which is
+// the order the PDA runs them in. There is no error recovery; the first
+// syntax error is thrown as runtime_error, with the message Parser gives.
+//
+// Like Parser, all state lives in the instance and one LRParser must not be
+// used from two threads.
+class LRParser {
+public:
+    // Reads the caller's tokens in place; keep them alive and unchanged
+    LRParser(TokenSpan tokens, const LineIndex& lines = LineIndex());
+    LRParser(vector<Token>&& tokens, const LineIndex& lines = LineIndex()) = delete;
+
+    LRParser(const LRParser&) = delete;         // trace steps point into this object
+    LRParser& operator=(const LRParser&) = delete;
+
+    void validate();                       // accept or throw, nothing else
+    void parse(Ast& ast);                  // builds the syntax tree
+
+    // Streams the shift/reduce steps to sink, for the same views as the
+    // PDA trace: shifts are Push steps of the terminal, reductions Reduce
+    // steps of the production. The stack shows grammar symbols over a "$"
+    // bottom; the LR states are left out. Trace files hold Parser traces
+    // only, so a FileTraceSink fails at the first reduction.
+    void parse(TraceSink& sink);
+
+    const vector<string>& getSymbolNames() const;
+    const vector<string>& getProductionLabels() const;   // "Reduce A → α"
+    size_t stateCount() const;
+
+private:
+    TokenSpan tokens;
+    Token eof;
+    LineIndex lines;
+    size_t pos = 0;
+
+    // LR states; while building a tree, values holds one entry per state
+    // above the bottom one: the node of a nonterminal, or the input position
+    // of a terminal
+    vector<uint32_t> states;
+    vector<NodeIndex> values;
+    Ast* ast = nullptr;
+
+    TraceSink* sink = nullptr;
+    StackArena stackArena;
+    const StackNode* traceTop = nullptr;
+    bool recycleStackNodes = false;
+
+    // Shared with every other LRParser; generated once per process
+    const int32_t* actions = nullptr;
+    const int32_t* gotos = nullptr;
+    const LRReduction* reductions = nullptr;
+    size_t terminalCount = 0;
+    size_t nonterminalCount = 0;
+    Symbol endMarker = NO_SYMBOL;
+    array<Symbol, UNKNOWN + 1> tokenTerminals;
+
+    template <typename TracePolicy> void run();
+    void reduce(const LRReduction& r);
+    Symbol lookaheadAt(size_t i) const;
+    const Token& tokenAt(size_t i) const { return i < tokens.size() ? tokens[i] : eof; }
+    void compactTraceStack();
+    [[noreturn]] void throwSyntaxError(const string& fallback) const;
+    string describePosition(size_t offset) const;
+};
+
+#endif
@@ -0,0 +1,154 @@
+#include <algorithm>
+#include <chrono>
+#include "parallel_parse.h"
+
+using namespace std;
+
+// Pieces per worker, so a slow piece does not leave the others idle
+static const size_t CHUNKS_PER_THREAD = 4;
+
+// Below this a single Parser on the calling thread is faster
+static const size_t MIN_PARALLEL_TOKENS = 1 << 14;
+
+
+// Parser takes an unknown "$" token for the end of input and never reads
+// past it. Returns the number of tokens up to and including the first one.
+static size_t tokensRead(TokenSpan tokens) {
+    for (size_t i = 0; i < tokens.size(); i++) {
+        if (tokens[i].type == UNKNOWN && tokens[i].value == "$") return i + 1;
+    }
+    return tokens.size();
+}
+
+
+static bool startsStatement(TokenSpan tokens, size_t i) {
+    if (tokens[i].type == PRINT) return true;
+    return tokens[i].type == IDENTIFIER && i + 1 < tokens.size() && tokens[i + 1].type == ASSIGN;
+}
+
+
+ParallelParser::ParallelParser(unsigned threadCount) {
+    if (threadCount == 0) threadCount = 1;
+    for (unsigned i = 0; i < threadCount; i++) threads.emplace_back(&ParallelParser::workerLoop, this);
+}
+
+
+ParallelParser::~ParallelParser() {
+    {
+        lock_guard<mutex> lock(batchMutex);
+        shuttingDown = true;
+    }
+    batchStarted.notify_all();
+    for (thread& t : threads) t.join();
+}
+
+
+ParallelParseStats ParallelParser::parse(TokenSpan tokens, const LineIndex& lines,
+                                         Ast& ast, vector<Diagnostic>& diagnostics) {
+    lock_guard<mutex> serialized(callMutex);
+    auto started = chrono::steady_clock::now();
+    ParallelParseStats stats;
+    size_t end = tokensRead(tokens);
+
+    if (end < MIN_PARALLEL_TOKENS || threads.size() == 1) {
+        Parser(tokens, lines).parse(ast, diagnostics);
+        stats.chunks = 1;
+        stats.seconds = chrono::duration<double>(chrono::steady_clock::now() - started).count();
+        return stats;
+    }
+
+    // Pieces build their nodes straight into this tree's slots for their
+    // tokens, so joining them copies nothing. Tokens after an in-band "$"
+    // are left out, as the serial parse never sees them.
+    batchTokens = tokens;
+    batchAst = &ast;
+    ast.reset(tokens);
+    vector<size_t> cuts = findCuts(threads.size() * CHUNKS_PER_THREAD, end);
+    chunks.clear();
+    chunks.resize(cuts.size() - 1);
+    for (size_t i = 0; i + 1 < cuts.size(); i++) {
+        chunks[i].first = cuts[i];
+        chunks[i].last = cuts[i + 1];
+    }
+
+    {
+        unique_lock<mutex> lock(batchMutex);
+        nextChunk = 0;
+        busyWorkers = threads.size();
+        batchGeneration++;
+        batchStarted.notify_all();
+        batchFinished.wait(lock, [&] { return busyWorkers == 0; });
+    }
+
+    // Join in source order. A piece that ended in an error may have been
+    // cut mid-statement, so it is parsed again together with the next one.
+    diagnostics.clear();
+    for (size_t i = 0; i < chunks.size(); i++) {
+        Chunk& chunk = chunks[i];
+        while (chunk.endsInError && i + 1 < chunks.size()) {
+            chunk.last = chunks[++i].last;
+            parseChunk(chunk);
+            stats.rejoined++;
+        }
+
+        ast.appendPart(chunk.ast);
+        for (Diagnostic d : chunk.diagnostics) {
+            d.tokenIndex += chunk.first;
+            d.line = lines.lineAt(d.offset);
+            d.column = lines.columnAt(d.offset);
+            diagnostics.push_back(std::move(d));
+        }
+    }
+
+    stats.chunks = chunks.size();
+    chunks.clear();
+    batchTokens = TokenSpan();
+    batchAst = nullptr;
+    stats.seconds = chrono::duration<double>(chrono::steady_clock::now() - started).count();
+    return stats;
+}
+
+
+// Cut the first `end` tokens near every 1/chunkCount of them, moved forward
+// to the next statement start. Returns the cut positions including 0 and end.
+vector<size_t> ParallelParser::findCuts(size_t chunkCount, size_t end) const {
+    const TokenSpan& tokens = batchTokens;
+    vector<size_t> cuts = { 0 };
+    for (size_t k = 1; k < chunkCount; k++) {
+        size_t i = max(end * k / chunkCount, cuts.back() + 1);
+        while (i < end && !startsStatement(tokens, i)) i++;
+        if (i >= end) break;
+        cuts.push_back(i);
+    }
+    cuts.push_back(end);
+    return cuts;
+}
+
+
+void ParallelParser::workerLoop() {
+    size_t seenGeneration = 0;
+    while (true) {
+        {
+            unique_lock<mutex> lock(batchMutex);
+            batchStarted.wait(lock, [&] { return shuttingDown || batchGeneration != seenGeneration; });
+            if (shuttingDown) return;
+            seenGeneration = batchGeneration;
+        }
+
+        for (size_t k = nextChunk++; k < chunks.size(); k = nextChunk++) parseChunk(chunks[k]);
+
+        lock_guard<mutex> lock(batchMutex);
+        if (--busyWorkers == 0) batchFinished.notify_one();
+    }
+}
+
+
+// Positions are fixed up when joining; the piece's Parser only knows its
+// own tokens, so it gets no line table
+void ParallelParser::parseChunk(Chunk& chunk) {
+    TokenSpan piece(batchTokens.begin() + chunk.first, chunk.last - chunk.first);
+    Parser parser(piece);
+    chunk.ast.resetPart(*batchAst, chunk.first, chunk.last - chunk.first);
+    parser.parse(chunk.ast, chunk.diagnostics);
+    chunk.endsInError = parser.errorAtEndOfInput();
+}
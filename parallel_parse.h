@@ -0,0 +1,75 @@
+#ifndef PARALLEL_PARSE_H
+#define PARALLEL_PARSE_H
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "syntactic.h"
+
+using namespace std;
+
+struct ParallelParseStats {
+    size_t chunks = 0;
+    size_t rejoined = 0;       // chunk boundaries that had to be parsed again
+    double seconds = 0.0;
+};
+
+// Parses large programs on a fixed pool of workers. Top-level statements are
+// independent (S -> Stmt S), and a statement starts either with print or
+// with IDENTIFIER followed by =, so the token buffer can be cut at such
+// tokens and every piece parsed by its own Parser, directly into its own
+// part of the final tree. The pieces and diagnostics are then joined in
+// source order.
+//
+// The result is that of Parser::parse(ast, diagnostics) over the whole
+// buffer, which stops at an unknown "$" token; nothing after it is parsed.
+// In broken input a cut can land where no statement really starts;
+// the piece before it then ends in an error, and the two pieces are parsed
+// again as one.
+//
+// One parse runs at a time; concurrent parse calls are serialized.
+class ParallelParser {
+public:
+    explicit ParallelParser(unsigned threadCount = thread::hardware_concurrency());
+    ~ParallelParser();
+
+    ParallelParser(const ParallelParser&) = delete;
+    ParallelParser& operator=(const ParallelParser&) = delete;
+
+    ParallelParseStats parse(TokenSpan tokens, const LineIndex& lines,
+                             Ast& ast, vector<Diagnostic>& diagnostics);
+
+    size_t threadCount() const { return threads.size(); }
+
+private:
+    struct Chunk {
+        size_t first;
+        size_t last;
+        Ast ast;
+        vector<Diagnostic> diagnostics;
+        bool endsInError = false;
+    };
+
+    void workerLoop();
+    void parseChunk(Chunk& chunk);
+    vector<size_t> findCuts(size_t chunkCount, size_t end) const;
+
+    vector<thread> threads;
+
+    mutex callMutex;
+    mutex batchMutex;
+    condition_variable batchStarted;
+    condition_variable batchFinished;
+    size_t batchGeneration = 0;
+    size_t busyWorkers = 0;
+    bool shuttingDown = false;
+
+    TokenSpan batchTokens;
+    Ast* batchAst = nullptr;
+    vector<Chunk> chunks;
+    atomic<size_t> nextChunk{0};
+};
+
+#endif
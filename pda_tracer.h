@@ -1,6 +1,9 @@
 #pragma once
 #include <vector>
 #include <string>
+#include <deque>
+#include <algorithm>
+#include <cstdint>
 #include "lexical.h"
 
 using namespace std;
@@ -10,8 +13,91 @@ struct StackFrame {
     int tokenIndex;        // Input token position
 };
 
+// One cell of the persistent parse stack. A push allocates a node on top of
+// the previous top and a pop only moves the top pointer, so each trace step
+// keeps its own top and shares everything below it with the other steps.
+struct StackNode {
+    const StackNode* below;
+    const string* symbol;     // points into the owning Parser's symbol names
+    size_t depth;
+};
+
+// Bump allocator for StackNodes; nodes are freed together with the arena
+class StackArena {
+public:
+    const StackNode* push(const StackNode* below, const string* symbol) {
+        nodes.push_back({below, symbol, below ? below->depth + 1 : 1});
+        return &nodes.back();
+    }
+    void clear() { nodes.clear(); }
+    size_t size() const { return nodes.size(); }
+
+private:
+    deque<StackNode> nodes;
+};
+
+// What a trace step did, in a form that can be replayed without the labels:
+// Push arg = symbol, Expand arg = production, Match arg = terminal.
+// LRParser shifts with Push steps and reduces with Reduce arg = production,
+// which replaces the production's right-hand side on the stack by its
+// left-hand side; trace files only hold Parser steps.
+enum class PDAOp : uint8_t { Push, Expand, Match, Accept, Error, Reduce };
+
+// A trace step. Steps are recorded without copying any strings: stackTop and
+// action point into the Parser that recorded the step, currentToken into
+// its token buffer (or the Parser, for end of input). They are only valid
+// while both are alive.
 struct PDAAction {
-    vector<string> stack;
+    const StackNode* stackTop;   // nullptr for an empty stack
+    const Token* currentToken;
+    const string* action;        // e.g., "push Expr", "match NUMBER → pop"
+    PDAOp op;
+    uint16_t arg;
+    uint32_t tokenIndex;         // position of currentToken in the parser input
+
+    // Full stack, bottom first, materialized on demand for display
+    vector<string> stackContents() const {
+        vector<string> contents;
+        contents.reserve(stackTop ? stackTop->depth : 0);
+        for (const StackNode* n = stackTop; n; n = n->below) contents.push_back(*n->symbol);
+        reverse(contents.begin(), contents.end());
+        return contents;
+    }
+
+    string topSymbol() const { return stackTop ? *stackTop->symbol : string(); }
+};
+
+// A trace step that owns its stack, e.g. rebuilt from a trace file or kept
+// by a ring buffer after the parser has moved on
+struct ReplayStep {
+    vector<string> stack;     // bottom first, like PDAAction::stackContents
     Token currentToken;
-    string action;    // e.g., "push Expr", "match NUMBER", "pop Factor"
+    string action;
+    PDAOp op;
+    uint16_t arg;
+};
+
+// Receives trace steps while the parser runs. Unless retainsStack() is true,
+// a step's stackTop is only valid inside onStep; the parser then recycles
+// stack nodes so its memory stays bounded by the current stack depth.
+class TraceSink {
+public:
+    virtual ~TraceSink() = default;
+    virtual void onStep(const PDAAction& step) = 0;
+    virtual void onError(const PDAAction&, const string&) {}
+    virtual bool retainsStack() const { return false; }
+};
+
+// Keeps every step, as the Syntactic tab needs for stepping back and forth
+class MemoryTraceSink : public TraceSink {
+public:
+    void onStep(const PDAAction& step) override { steps.push_back(step); }
+    bool retainsStack() const override { return true; }
+
+    const vector<PDAAction>& getSteps() const { return steps; }
+    vector<PDAAction> take() { return std::move(steps); }
+    void clear() { steps.clear(); }
+
+private:
+    vector<PDAAction> steps;
 };
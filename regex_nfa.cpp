@@ -0,0 +1,256 @@
+#include <bitset>
+#include <stdexcept>
+#include "regex_nfa.h"
+
+using namespace std;
+
+typedef bitset<256> CharSet;
+
+
+namespace {
+
+// Recursive descent over the pattern, building fragments bottom-up:
+//   alt    := concat ('|' concat)*
+//   concat := repeat*
+//   repeat := atom ('*' | '+' | '?')*
+//   atom   := '(' alt ')' | '[' class ']' | '.' | escape | literal
+class RegexCompiler {
+public:
+    RegexCompiler(const string& p, AutomatonArena& a) : pattern(p), arena(a) {}
+
+    NFA compile() {
+        NFA nfa = parseAlternation();
+        if (pos < pattern.size()) fail("unbalanced ')'");
+        return nfa;
+    }
+
+private:
+    const string& pattern;
+    AutomatonArena& arena;
+    size_t pos = 0;
+
+    [[noreturn]] void fail(const string& why) const {
+        throw std::runtime_error("Regex error: " + why + " at position " + std::to_string(pos) +
+                                 " in '" + pattern + "'");
+    }
+
+    bool atEnd() const { return pos >= pattern.size(); }
+    char peek() const { return pattern[pos]; }
+
+    NFA emptyFragment() {
+        NFAState* start = arena.newState();
+        NFAState* accept = arena.newState();
+        start->epsilon.push_back(accept);
+        return { start, accept };
+    }
+
+    NFA charSetFragment(const CharSet& chars) {
+        NFAState* start = arena.newState();
+        NFAState* accept = arena.newState();
+        for (int c = 1; c < 256; c++) {
+            if (chars[c]) start->transitions[static_cast<char>(c)].push_back(accept);
+        }
+        return { start, accept };
+    }
+
+    NFA parseAlternation() {
+        NFA left = parseConcatenation();
+        if (atEnd() || peek() != '|') return left;
+
+        NFAState* start = arena.newState();
+        NFAState* accept = arena.newState();
+        start->epsilon.push_back(left.start);
+        left.accept->epsilon.push_back(accept);
+
+        while (!atEnd() && peek() == '|') {
+            pos++;
+            NFA branch = parseConcatenation();
+            start->epsilon.push_back(branch.start);
+            branch.accept->epsilon.push_back(accept);
+        }
+        return { start, accept };
+    }
+
+    NFA parseConcatenation() {
+        if (atEnd() || peek() == '|' || peek() == ')') return emptyFragment();
+
+        NFA result = parseRepetition();
+        while (!atEnd() && peek() != '|' && peek() != ')') {
+            NFA next = parseRepetition();
+            result.accept->epsilon.push_back(next.start);
+            result.accept = next.accept;
+        }
+        return result;
+    }
+
+    NFA parseRepetition() {
+        NFA inner = parseAtom();
+
+        while (!atEnd() && (peek() == '*' || peek() == '+' || peek() == '?')) {
+            char op = pattern[pos++];
+            NFAState* start = arena.newState();
+            NFAState* accept = arena.newState();
+
+            start->epsilon.push_back(inner.start);
+            if (op != '+') start->epsilon.push_back(accept);   // may skip
+            if (op != '?') inner.accept->epsilon.push_back(inner.start);   // may loop
+            inner.accept->epsilon.push_back(accept);
+
+            inner = { start, accept };
+        }
+        return inner;
+    }
+
+    NFA parseAtom() {
+        char c = pattern[pos];
+        switch (c) {
+            case '(': {
+                pos++;
+                NFA inner = parseAlternation();
+                if (atEnd() || peek() != ')') fail("missing ')'");
+                pos++;
+                return inner;
+            }
+            case '[':
+                return charSetFragment(parseClass());
+            case '.': {
+                pos++;
+                CharSet any;
+                any.set();
+                any.reset('\n');
+                return charSetFragment(any);
+            }
+            case '*': case '+': case '?':
+                fail(string("nothing to repeat before '") + c + "'");
+            case ')':
+                fail("unbalanced ')'");
+            case '\\':
+                pos++;
+                return charSetFragment(parseEscape());
+            default: {
+                pos++;
+                CharSet single;
+                single.set(static_cast<unsigned char>(c));
+                return charSetFragment(single);
+            }
+        }
+    }
+
+    // Called with pos just past a backslash
+    CharSet parseEscape() {
+        if (atEnd()) fail("dangling '\\'");
+        char c = pattern[pos++];
+        CharSet chars;
+
+        switch (c) {
+            case 'd': for (int ch = '0'; ch <= '9'; ch++) chars.set(ch); break;
+            case 'w':
+                for (int ch = 'a'; ch <= 'z'; ch++) chars.set(ch);
+                for (int ch = 'A'; ch <= 'Z'; ch++) chars.set(ch);
+                for (int ch = '0'; ch <= '9'; ch++) chars.set(ch);
+                chars.set('_');
+                break;
+            case 's': for (char ch : string(" \t\n\r\f\v")) chars.set(static_cast<unsigned char>(ch)); break;
+            case 'n': chars.set('\n'); break;
+            case 't': chars.set('\t'); break;
+            case 'r': chars.set('\r'); break;
+            default:  chars.set(static_cast<unsigned char>(c)); break;
+        }
+        return chars;
+    }
+
+    // Called with pos on '['
+    CharSet parseClass() {
+        pos++;
+        bool negate = !atEnd() && peek() == '^';
+        if (negate) pos++;
+
+        CharSet chars;
+        bool first = true;
+        while (!atEnd() && (peek() != ']' || first)) {
+            first = false;
+
+            if (peek() == '\\') {
+                pos++;
+                CharSet escaped = parseEscape();
+                // A single escaped char may still start a range, e.g. [\.-9]
+                if (escaped.count() != 1 || !isRangeAhead()) {
+                    chars |= escaped;
+                    continue;
+                }
+                int lo = firstChar(escaped);
+                addRange(chars, lo);
+                continue;
+            }
+
+            int lo = static_cast<unsigned char>(pattern[pos++]);
+            if (isRangeAhead()) {
+                addRange(chars, lo);
+            } else {
+                chars.set(lo);
+            }
+        }
+        if (atEnd()) fail("missing ']'");
+        pos++;
+
+        if (negate) {
+            chars.flip();
+            chars.reset('\n');
+        }
+        chars.reset(0);
+        return chars;
+    }
+
+    bool isRangeAhead() const {
+        return pos + 1 < pattern.size() && pattern[pos] == '-' && pattern[pos + 1] != ']';
+    }
+
+    // Called with pos on the '-' of "lo-hi"
+    void addRange(CharSet& chars, int lo) {
+        pos++;
+        int hi = static_cast<unsigned char>(pattern[pos++]);
+        if (hi == '\\') {
+            CharSet escaped = parseEscape();
+            if (escaped.count() != 1) fail("class shorthand cannot end a range");
+            hi = firstChar(escaped);
+        }
+        if (hi < lo) fail("reversed range");
+        for (int ch = lo; ch <= hi; ch++) chars.set(ch);
+    }
+
+    static int firstChar(const CharSet& chars) {
+        for (int ch = 0; ch < 256; ch++) {
+            if (chars[ch]) return ch;
+        }
+        return 0;
+    }
+};
+
+}
+
+
+// A token that can match nothing would stall the scanner at one position
+static bool matchesEmpty(const NFA& nfa) {
+    vector<NFAState*> pending = { nfa.start };
+    set<NFAState*> seen = { nfa.start };
+    while (!pending.empty()) {
+        NFAState* s = pending.back();
+        pending.pop_back();
+        if (s == nfa.accept) return true;
+        for (NFAState* t : s->epsilon) {
+            if (seen.insert(t).second) pending.push_back(t);
+        }
+    }
+    return false;
+}
+
+
+NFA compileRegex(const string& pattern, TokenType type, AutomatonArena& arena) {
+    NFA nfa = RegexCompiler(pattern, arena).compile();
+    if (matchesEmpty(nfa)) {
+        throw std::runtime_error("Regex error: '" + pattern + "' matches the empty string");
+    }
+    nfa.accept->isAccepting = true;
+    nfa.accept->tokenType = type;
+    return nfa;
+}
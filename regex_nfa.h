@@ -0,0 +1,22 @@
+#ifndef REGEX_NFA_H
+#define REGEX_NFA_H
+
+#include <string>
+#include "lexical.h"
+
+using namespace std;
+
+// Thompson construction from a regular expression, so token rules can be
+// written as patterns instead of hand-numbered state graphs. The result
+// plugs into combineNFAs/convertNFAtoDFA like createNumberNFA's.
+//
+// Supported syntax:
+//   ab  a|b  a*  a+  a?  (a)      concatenation, alternation, repetition
+//   [abc] [a-z0-9_] [^)]          character classes, ranges, negation
+//   .                             any character except newline
+//   \d \w \s  \. \\ \n \t ...     class shorthands and escapes
+//
+// Throws runtime_error on malformed patterns. All states go into `arena`.
+NFA compileRegex(const string& pattern, TokenType type, AutomatonArena& arena);
+
+#endif
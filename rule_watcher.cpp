@@ -0,0 +1,138 @@
+#include <chrono>
+#include <filesystem>
+#include <stdexcept>
+#include "rule_watcher.h"
+
+#ifdef __linux__
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+static const int WATCH_INTERVAL_MS = 200;
+
+
+TokenRuleWatcher::TokenRuleWatcher(const string& path) : specPath(path) {
+    if (!reload()) {
+        // Never start without a lexer; the spec can still be fixed later
+        atomic_store(&lexer, buildLexer(defaultTokenRules()));
+    }
+}
+
+
+TokenRuleWatcher::~TokenRuleWatcher() {
+    stop();
+}
+
+
+void TokenRuleWatcher::start() {
+    if (running.exchange(true)) return;
+    worker = thread(&TokenRuleWatcher::run, this);
+}
+
+
+void TokenRuleWatcher::stop() {
+    running = false;
+    if (worker.joinable()) worker.join();
+}
+
+
+shared_ptr<const CompiledLexer> TokenRuleWatcher::current() const {
+    return atomic_load(&lexer);
+}
+
+
+string TokenRuleWatcher::lastError() const {
+    lock_guard<mutex> lock(errorMutex);
+    return error;
+}
+
+
+bool TokenRuleWatcher::reload() {
+    lock_guard<mutex> reloading(reloadMutex);
+    shared_ptr<const CompiledLexer> rebuilt;
+    try {
+        TokenRules rules = loadTokenRules(specPath);
+        // An empty or half-written spec parses fine but lexes nothing useful
+        if (rules.operators.empty()) throw std::runtime_error("Token rules: " + specPath + " defines no operators");
+        if (rules.keywords.empty()) throw std::runtime_error("Token rules: " + specPath + " defines no keywords");
+        rebuilt = buildLexer(rules);
+    } catch (const std::runtime_error& e) {
+        lock_guard<mutex> lock(errorMutex);
+        error = e.what();
+        return false;
+    }
+
+    atomic_store(&lexer, rebuilt);
+    generationCount++;
+
+    lock_guard<mutex> lock(errorMutex);
+    error.clear();
+    return true;
+}
+
+
+void TokenRuleWatcher::run() {
+#ifdef __linux__
+    waitForChangesInotify();
+#else
+    waitForChangesPolling();
+#endif
+}
+
+
+void TokenRuleWatcher::waitForChangesInotify() {
+#ifdef __linux__
+    filesystem::path spec(specPath);
+    filesystem::path dir = spec.parent_path().empty() ? filesystem::path(".") : spec.parent_path();
+    string fileName = spec.filename().string();
+
+    // Watch the directory, not the file: editors usually save by writing a
+    // temp file and renaming it over the spec, which drops a file watch.
+    // IN_CREATE is left out on purpose: it fires before the new file has
+    // any content.
+    int fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (fd < 0 || inotify_add_watch(fd, dir.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO) < 0) {
+        if (fd >= 0) close(fd);
+        waitForChangesPolling();
+        return;
+    }
+
+    alignas(inotify_event) char buffer[4096];
+    while (running) {
+        pollfd pfd = { fd, POLLIN, 0 };
+        if (poll(&pfd, 1, WATCH_INTERVAL_MS) <= 0) continue;
+
+        bool changed = false;
+        ssize_t len;
+        while ((len = read(fd, buffer, sizeof(buffer))) > 0) {
+            for (char* p = buffer; p < buffer + len; ) {
+                const inotify_event* ev = reinterpret_cast<const inotify_event*>(p);
+                if (ev->len > 0 && fileName == ev->name) changed = true;
+                p += sizeof(inotify_event) + ev->len;
+            }
+        }
+        if (changed) reload();
+    }
+    close(fd);
+#else
+    waitForChangesPolling();
+#endif
+}
+
+
+void TokenRuleWatcher::waitForChangesPolling() {
+    error_code ec;
+    auto lastWrite = filesystem::last_write_time(specPath, ec);
+
+    while (running) {
+        this_thread::sleep_for(chrono::milliseconds(WATCH_INTERVAL_MS));
+        auto now = filesystem::last_write_time(specPath, ec);
+        if (!ec && now != lastWrite) {
+            lastWrite = now;
+            reload();
+        }
+    }
+}
@@ -0,0 +1,53 @@
+#ifndef RULE_WATCHER_H
+#define RULE_WATCHER_H
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include "lexical.h"
+
+using namespace std;
+
+// Keeps a CompiledLexer in sync with a token rule spec file (see
+// parseTokenRules). A background thread waits for the file to change
+// (inotify on Linux, mtime polling elsewhere), rebuilds the DFA off the
+// tokenization path and publishes it with an atomic pointer swap.
+//
+// Readers take a snapshot with current() and keep it for a whole input; the
+// previous lexer is freed when its last reader drops the snapshot. A spec
+// that fails to load, or defines no operators or no keywords, leaves the
+// current lexer in place and sets lastError().
+class TokenRuleWatcher {
+public:
+    explicit TokenRuleWatcher(const string& specPath);
+    ~TokenRuleWatcher();
+
+    void start();
+    void stop();
+
+    shared_ptr<const CompiledLexer> current() const;
+    size_t generation() const { return generationCount.load(); }
+    string lastError() const;
+
+    // Reload synchronously, e.g. right after the spec was written
+    bool reload();
+
+private:
+    void run();
+    void waitForChangesInotify();
+    void waitForChangesPolling();
+
+    string specPath;
+    shared_ptr<const CompiledLexer> lexer;   // only via atomic_load/atomic_store
+    atomic<size_t> generationCount{0};
+    atomic<bool> running{false};
+    thread worker;
+
+    mutex reloadMutex;
+    mutable mutex errorMutex;
+    string error;
+};
+
+#endif
@@ -0,0 +1,330 @@
+#include <cstdlib>
+#include <stdexcept>
+#include <utility>
+#include "grammar.h"
+#include "static_parse.h"
+#include "syntactic.h"
+
+using namespace std;
+
+// --- The grammar as constexpr data ---
+
+// DEFAULT_GRAMMAR of grammar.cpp, symbol for symbol: terminals in %terminals
+// order, "$", the nonterminals in order of definition, then the actions.
+// checkAgainstDefaultGrammar() makes sure the two stay the same.
+enum StaticSymbol : uint8_t {
+    T_IDENTIFIER, T_NUMBER, T_PRINT, T_FUNCTION, T_ASSIGN, T_PLUS, T_MINUS,
+    T_MULTIPLY, T_DIVIDE, T_MOD, T_LPAREN, T_RPAREN, T_END,
+    N_S, N_STMT, N_EXPR, N_EXPR_TAIL, N_TERM, N_TERM_TAIL, N_FACTOR,
+    A_NUMBER, A_VARIABLE, A_CALL, A_BINARY, A_ASSIGN, A_PRINT,
+    STATIC_SYMBOL_COUNT,
+    T_INVALID = 0xFF            // a token no terminal stands for
+};
+
+static constexpr size_t STATIC_TERMINALS = N_S;
+static constexpr size_t STATIC_NONTERMINALS = A_NUMBER - N_S;
+
+static const char* const STATIC_SYMBOL_NAMES[STATIC_SYMBOL_COUNT] = {
+    "IDENTIFIER", "NUMBER", "print", "FUNCTION", "=", "+", "-", "*", "/", "%", "(", ")", "$",
+    "S", "Stmt", "Expr", "Expr'", "Term", "Term'", "Factor",
+    "{number}", "{variable}", "{call}", "{binary}", "{assign}", "{print}"
+};
+
+// Right-hand sides with their actions, as written in the spec
+struct StaticProduction {
+    uint8_t lhs;
+    uint8_t length;
+    uint8_t items[5];
+};
+
+static constexpr StaticProduction STATIC_PRODUCTIONS[] = {
+    { N_S,         2, { N_STMT, N_S } },
+    { N_S,         0, {} },
+    { N_STMT,      4, { T_IDENTIFIER, T_ASSIGN, N_EXPR, A_ASSIGN } },
+    { N_STMT,      5, { T_PRINT, T_LPAREN, N_EXPR, T_RPAREN, A_PRINT } },
+    { N_EXPR,      2, { N_TERM, N_EXPR_TAIL } },
+    { N_EXPR_TAIL, 4, { T_PLUS, N_TERM, A_BINARY, N_EXPR_TAIL } },
+    { N_EXPR_TAIL, 4, { T_MINUS, N_TERM, A_BINARY, N_EXPR_TAIL } },
+    { N_EXPR_TAIL, 0, {} },
+    { N_TERM,      2, { N_FACTOR, N_TERM_TAIL } },
+    { N_TERM_TAIL, 4, { T_MULTIPLY, N_FACTOR, A_BINARY, N_TERM_TAIL } },
+    { N_TERM_TAIL, 4, { T_DIVIDE, N_FACTOR, A_BINARY, N_TERM_TAIL } },
+    { N_TERM_TAIL, 4, { T_MOD, N_FACTOR, A_BINARY, N_TERM_TAIL } },
+    { N_TERM_TAIL, 0, {} },
+    { N_FACTOR,    2, { T_NUMBER, A_NUMBER } },
+    { N_FACTOR,    2, { T_IDENTIFIER, A_VARIABLE } },
+    { N_FACTOR,    5, { T_FUNCTION, T_LPAREN, N_EXPR, T_RPAREN, A_CALL } },
+    { N_FACTOR,    3, { T_LPAREN, N_EXPR, T_RPAREN } },
+};
+static constexpr size_t STATIC_PRODUCTION_COUNT = sizeof STATIC_PRODUCTIONS / sizeof STATIC_PRODUCTIONS[0];
+
+struct StaticTable {
+    int8_t entries[STATIC_NONTERMINALS][STATIC_TERMINALS];   // production, -1 = error
+    bool conflict;
+};
+
+// FIRST, FOLLOW and the LL(1) table, the same way computeFirstFollow and
+// buildLL1Table get them, but evaluated by the compiler
+static constexpr StaticTable buildStaticTable() {
+    bool nullable[STATIC_NONTERMINALS] = {};
+    bool first[STATIC_NONTERMINALS][STATIC_TERMINALS] = {};
+    bool follow[STATIC_NONTERMINALS][STATIC_TERMINALS] = {};
+
+    for (bool changed = true; changed;) {
+        changed = false;
+        for (const StaticProduction& p : STATIC_PRODUCTIONS) {
+            bool allNullable = true;
+            for (size_t i = 0; i < p.length && allNullable; i++) {
+                uint8_t s = p.items[i];
+                if (s >= A_NUMBER) continue;
+                if (s < STATIC_TERMINALS) {
+                    changed |= !first[p.lhs - N_S][s];
+                    first[p.lhs - N_S][s] = true;
+                    allNullable = false;
+                    continue;
+                }
+                for (size_t t = 0; t < STATIC_TERMINALS; t++) {
+                    if (first[s - N_S][t] && !first[p.lhs - N_S][t]) {
+                        first[p.lhs - N_S][t] = true;
+                        changed = true;
+                    }
+                }
+                allNullable = nullable[s - N_S];
+            }
+            if (allNullable && !nullable[p.lhs - N_S]) {
+                nullable[p.lhs - N_S] = true;
+                changed = true;
+            }
+        }
+    }
+
+    follow[0][T_END] = true;
+    for (bool changed = true; changed;) {
+        changed = false;
+        for (const StaticProduction& p : STATIC_PRODUCTIONS) {
+            bool trailer[STATIC_TERMINALS] = {};
+            for (size_t t = 0; t < STATIC_TERMINALS; t++) trailer[t] = follow[p.lhs - N_S][t];
+            for (size_t i = p.length; i > 0; --i) {
+                uint8_t s = p.items[i - 1];
+                if (s >= A_NUMBER) continue;
+                if (s < STATIC_TERMINALS) {
+                    for (size_t t = 0; t < STATIC_TERMINALS; t++) trailer[t] = t == s;
+                    continue;
+                }
+                for (size_t t = 0; t < STATIC_TERMINALS; t++) {
+                    if (trailer[t] && !follow[s - N_S][t]) {
+                        follow[s - N_S][t] = true;
+                        changed = true;
+                    }
+                }
+                for (size_t t = 0; t < STATIC_TERMINALS; t++) {
+                    trailer[t] = (nullable[s - N_S] && trailer[t]) || first[s - N_S][t];
+                }
+            }
+        }
+    }
+
+    StaticTable table = {};
+    for (size_t n = 0; n < STATIC_NONTERMINALS; n++) {
+        for (size_t t = 0; t < STATIC_TERMINALS; t++) table.entries[n][t] = -1;
+    }
+    for (size_t index = 0; index < STATIC_PRODUCTION_COUNT; index++) {
+        const StaticProduction& p = STATIC_PRODUCTIONS[index];
+        bool lookaheads[STATIC_TERMINALS] = {};
+        bool allNullable = true;
+        for (size_t i = 0; i < p.length && allNullable; i++) {
+            uint8_t s = p.items[i];
+            if (s >= A_NUMBER) continue;
+            if (s < STATIC_TERMINALS) {
+                lookaheads[s] = true;
+                allNullable = false;
+                continue;
+            }
+            for (size_t t = 0; t < STATIC_TERMINALS; t++) lookaheads[t] |= first[s - N_S][t];
+            allNullable = nullable[s - N_S];
+        }
+        for (size_t t = 0; t < STATIC_TERMINALS; t++) {
+            if (allNullable) lookaheads[t] |= follow[p.lhs - N_S][t];
+            if (!lookaheads[t]) continue;
+            int8_t& cell = table.entries[p.lhs - N_S][t];
+            if (cell >= 0 && cell != static_cast<int8_t>(index)) table.conflict = true;
+            else cell = static_cast<int8_t>(index);
+        }
+    }
+    return table;
+}
+
+static constexpr StaticTable STATIC_TABLE = buildStaticTable();
+static_assert(!STATIC_TABLE.conflict, "StaticParser's grammar is not LL(1)");
+
+// Terminal for each token type; UNKNOWN is decided by the token's value
+static constexpr uint8_t STATIC_TOKEN_TERMINALS[UNKNOWN + 1] = {
+    T_IDENTIFIER, T_NUMBER, T_PLUS, T_MINUS, T_MULTIPLY, T_DIVIDE, T_MOD,
+    T_ASSIGN, T_LPAREN, T_RPAREN, T_PRINT, T_FUNCTION, T_INVALID, T_INVALID
+};
+static_assert(STATIC_TOKEN_TERMINALS[FUNCTION] == T_FUNCTION && STATIC_TOKEN_TERMINALS[WHITESPACE] == T_INVALID,
+              "STATIC_TOKEN_TERMINALS is out of step with TokenType");
+
+// Nonterminal calls deeper than this are left to the table-driven Parser
+static const size_t MAX_DESCENT_DEPTH = 1500;
+
+
+// The constexpr grammar is a copy; refuse to run if grammar.cpp has moved on
+static void checkAgainstDefaultGrammar() {
+    static const bool checked = [] {
+        Grammar g = defaultGrammar();
+        bool same = g.symbolNames.size() == A_NUMBER && g.productions.size() == STATIC_PRODUCTION_COUNT;
+        for (size_t i = 0; same && i < g.symbolNames.size(); i++) same = g.symbolNames[i] == STATIC_SYMBOL_NAMES[i];
+        for (size_t p = 0; same && p < STATIC_PRODUCTION_COUNT; p++) {
+            const GrammarProduction& gp = g.productions[p];
+            same = gp.lhs == STATIC_PRODUCTIONS[p].lhs && gp.items.size() == STATIC_PRODUCTIONS[p].length;
+            for (size_t k = 0; same && k < gp.items.size(); k++) {
+                same = gp.items[k] == STATIC_SYMBOL_NAMES[STATIC_PRODUCTIONS[p].items[k]];
+            }
+        }
+        if (!same) throw std::runtime_error("StaticParser: its compiled-in grammar no longer matches grammar.cpp");
+        return true;
+    }();
+    (void)checked;
+}
+
+
+// --- The generated parser ---
+
+// Thrown out of the descent to hand the input to Parser
+struct StaticParseFailed {};
+
+template <bool BuildsAst>
+struct StaticDescent {
+    StaticParser& parser;
+
+    uint8_t lookahead() const {
+        if (parser.pos >= parser.tokens.size()) return T_END;
+        const Token& t = parser.tokens[parser.pos];
+        if (t.type != UNKNOWN) return STATIC_TOKEN_TERMINALS[t.type];
+        // Parser takes an unknown "$" for the end of input as well
+        return t.value == "$" ? T_END : T_INVALID;
+    }
+
+    void program() {
+        nonterminal<N_S>(0);
+        if (lookahead() != T_END) throw StaticParseFailed();
+    }
+
+    template <uint8_t N>
+    void nonterminal(size_t depth) {
+        if (depth > MAX_DESCENT_DEPTH) throw StaticParseFailed();
+        for (bool again = true; again;) {
+            switch (lookahead()) {
+                case T_IDENTIFIER: again = expand<N, T_IDENTIFIER>(depth); break;
+                case T_NUMBER:     again = expand<N, T_NUMBER>(depth); break;
+                case T_PRINT:      again = expand<N, T_PRINT>(depth); break;
+                case T_FUNCTION:   again = expand<N, T_FUNCTION>(depth); break;
+                case T_ASSIGN:     again = expand<N, T_ASSIGN>(depth); break;
+                case T_PLUS:       again = expand<N, T_PLUS>(depth); break;
+                case T_MINUS:      again = expand<N, T_MINUS>(depth); break;
+                case T_MULTIPLY:   again = expand<N, T_MULTIPLY>(depth); break;
+                case T_DIVIDE:     again = expand<N, T_DIVIDE>(depth); break;
+                case T_MOD:        again = expand<N, T_MOD>(depth); break;
+                case T_LPAREN:     again = expand<N, T_LPAREN>(depth); break;
+                case T_RPAREN:     again = expand<N, T_RPAREN>(depth); break;
+                case T_END:        again = expand<N, T_END>(depth); break;
+                default:           throw StaticParseFailed();
+            }
+        }
+    }
+
+    // Runs the production for lookahead T. Returns true when it ended by
+    // expanding N again, which the caller does by looping.
+    template <uint8_t N, uint8_t T>
+    bool expand(size_t depth) {
+        constexpr int production = STATIC_TABLE.entries[N - N_S][T];
+        if constexpr (production < 0) {
+            throw StaticParseFailed();
+        } else {
+            return run<production, T>(make_index_sequence<STATIC_PRODUCTIONS[production].length>(), depth);
+        }
+    }
+
+    template <size_t P, uint8_t T, size_t... I>
+    bool run(index_sequence<I...>, [[maybe_unused]] size_t depth) {
+        constexpr const StaticProduction& p = STATIC_PRODUCTIONS[P];
+        [[maybe_unused]] uint32_t start = static_cast<uint32_t>(parser.pos);
+        (item<P, T, I>(start, depth), ...);
+        return p.length > 0 && p.items[p.length - 1] == p.lhs;
+    }
+
+    template <size_t P, uint8_t T, size_t I>
+    void item(uint32_t start, size_t depth) {
+        constexpr const StaticProduction& p = STATIC_PRODUCTIONS[P];
+        constexpr uint8_t symbol = p.items[I];
+        if constexpr (I + 1 == p.length && symbol == p.lhs) {
+            // Tail expansion of the same nonterminal: the caller loops
+        } else if constexpr (symbol < STATIC_TERMINALS) {
+            // The first terminal is the lookahead the production was chosen by
+            if constexpr (I > 0 || symbol != T) {
+                if (lookahead() != symbol) throw StaticParseFailed();
+            }
+            parser.pos++;
+        } else if constexpr (symbol < A_NUMBER) {
+            nonterminal<symbol>(depth + 1);
+        } else if constexpr (BuildsAst) {
+            action<symbol>(start);
+        }
+    }
+
+    // Parser::runAction, one action at a time
+    template <uint8_t A>
+    void action(uint32_t start) {
+        Ast& ast = *parser.ast;
+        vector<NodeIndex>& values = parser.values;
+        const Token& token = parser.tokens[start];
+        if constexpr (A == A_NUMBER) {
+            values.push_back(ast.addNumber(start, strtod(token.value.c_str(), nullptr)));
+        } else if constexpr (A == A_VARIABLE) {
+            values.push_back(ast.add(AstKind::Variable, 0, start, NO_NODE, NO_NODE));
+        } else if constexpr (A == A_CALL) {
+            values.back() = ast.add(AstKind::Call, 0, start, values.back(), NO_NODE);
+        } else if constexpr (A == A_BINARY) {
+            NodeIndex right = values.back();
+            values.pop_back();
+            values.back() = ast.add(AstKind::Binary, token.value[0], start, values.back(), right);
+        } else {
+            AstKind kind = A == A_ASSIGN ? AstKind::Assign : AstKind::Print;
+            ast.appendStatement(ast.add(kind, 0, start, values.back(), NO_NODE));
+            values.pop_back();
+        }
+    }
+};
+
+
+StaticParser::StaticParser(TokenSpan t, const LineIndex& l) : tokens(t), lines(l) {
+    checkAgainstDefaultGrammar();
+}
+
+
+void StaticParser::validate() {
+    pos = 0;
+    try {
+        StaticDescent<false>{*this}.program();
+        return;
+    } catch (const StaticParseFailed&) {
+    }
+    Parser(tokens, lines).validate();
+}
+
+
+void StaticParser::parse(Ast& tree) {
+    pos = 0;
+    tree.reset(tokens);
+    ast = &tree;
+    values.clear();
+    try {
+        StaticDescent<true>{*this}.program();
+        ast = nullptr;
+        return;
+    } catch (const StaticParseFailed&) {
+    }
+    ast = nullptr;
+    Parser(tokens, lines).parse(tree);
+}
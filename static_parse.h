@@ -0,0 +1,43 @@
+#ifndef STATIC_PARSE_H
+#define STATIC_PARSE_H
+
+#include <vector>
+#include "ast.h"
+#include "lexical.h"
+
+using namespace std;
+
+template <bool BuildsAst> struct StaticDescent;
+
+// Recursive-descent parser for the calculator grammar, generated by the
+// compiler: the grammar is constexpr data, its LL(1) table is computed at
+// compile time, and templates turn every nonterminal into a function that
+// switches on the lookahead and has its productions inlined. There is no
+// table lookup or parse stack at run time, and a nonterminal that ends by
+// expanding itself (S, Expr', Term') loops instead of recursing.
+//
+// It accepts the same programs as Parser and builds the same trees. On a
+// syntax error, or nesting too deep for the call stack, the input is handed
+// to the table-driven Parser, which reports the error in its usual words.
+class StaticParser {
+public:
+    // Reads the caller's tokens in place; keep them alive and unchanged
+    StaticParser(TokenSpan tokens, const LineIndex& lines = LineIndex());
+    StaticParser(vector<Token>&& tokens, const LineIndex& lines = LineIndex()) = delete;
+
+    void validate();
+    void parse(Ast& ast);
+
+private:
+    template <bool BuildsAst> friend struct StaticDescent;
+
+    TokenSpan tokens;
+    LineIndex lines;
+    size_t pos = 0;
+
+    // Operands waiting for their parent, as in Parser
+    Ast* ast = nullptr;
+    vector<NodeIndex> values;
+};
+
+#endif
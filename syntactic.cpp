@@ -1,158 +1,679 @@
 #include <iostream>
 #include <stdexcept>
 #include <algorithm>
+#include <cstdlib>
 #include "syntactic.h"
 
-Token previousToken(UNKNOWN, "", 1);
-bool hasPrevious = false;
+// Trace labels that are not tied to a production or terminal
+static const string PUSH_END_LABEL = "push $";
+static const string ACCEPT_LABEL = "ACCEPTED";
+static const string ERROR_LABEL = "ERROR";
 
-Parser::Parser(const std::vector<Token>& t) : tokens(t), pos(0) {
+static size_t endOfInputOffset(TokenSpan tokens) {
+    return tokens.empty() ? 0 : tokens.back().offset + tokens.back().lexeme.size();
+}
+
+Parser::Parser(TokenSpan t, const LineIndex& l)
+    : tokens(t), eof(UNKNOWN, "$", endOfInputOffset(t)), lines(l), pos(0) {
     setupTable(); 
 }
 
+Parser::Parser(TokenSource& s, const LineIndex& l)
+    : eof(UNKNOWN, "$", 0), lines(l), stream(&s) {
+    setupTable();
+}
+
+
+
+// Terminal names the grammar may use, and the token type each one matches
+static const pair<const char*, TokenType> TERMINAL_TOKENS[] = {
+    {"IDENTIFIER", IDENTIFIER}, {"NUMBER", NUMBER}, {"print", PRINT}, {"FUNCTION", FUNCTION},
+    {"=", ASSIGN}, {"+", PLUS}, {"-", MINUS}, {"*", MULTIPLY}, {"/", DIVIDE}, {"%", MOD},
+    {"(", LPAREN}, {")", RPAREN}
+};
+
+static const map<string, AstAction> AST_ACTIONS = {
+    {"{number}", ActNumber}, {"{variable}", ActVariable}, {"{call}", ActCall},
+    {"{binary}", ActBinary}, {"{assign}", ActAssign}, {"{print}", ActPrint}
+};
+
+bool terminalTokenType(const string& terminal, TokenType& type) {
+    auto known = find_if(begin(TERMINAL_TOKENS), end(TERMINAL_TOKENS),
+                         [&](const auto& entry) { return terminal == entry.first; });
+    if (known == end(TERMINAL_TOKENS)) return false;
+    type = known->second;
+    return true;
+}
+
+bool astActionNamed(const string& item, AstAction& action) {
+    auto known = AST_ACTIONS.find(item);
+    if (known == AST_ACTIONS.end()) return false;
+    action = known->second;
+    return true;
+}
+
+// Everything Parser needs from the grammar. Parsers are made per chunk,
+// per edit and per fallback, so this is built once per process rather than
+// per Parser.
+struct GeneratedGrammar {
+    Grammar grammar;
+    LL1Table table;
+    vector<uint8_t> follow;                         // [nonterminal][terminal], for error recovery
+    Symbol exprSymbol;
+
+    vector<Parser::Production> productions;
+    vector<Symbol> productionSymbols;
+    vector<Symbol> astSymbols;
+    vector<string> productionLabels;                // "Expand A → α" for the trace
+    vector<string> matchLabels;                     // "match a → pop", per terminal
+    string pushStartLabel;                          // "push S"
+
+    vector<uint8_t> terminalFlags;                  // by Symbol
+    array<Symbol, UNKNOWN + 1> tokenTerminals;      // by TokenType
+
+    GeneratedGrammar();
+};
+
+
+GeneratedGrammar::GeneratedGrammar() : grammar(defaultGrammar()) {
+    const Grammar& g = grammar;
+    table = buildLL1Table(g);
+    if (!table.conflicts.empty()) {
+        throw std::runtime_error("Grammar is not LL(1): " + describeConflict(g, table.conflicts.front()));
+    }
+    FirstFollowSets sets = computeFirstFollow(g);
+    follow.assign(g.nonterminalCount() * g.terminalCount, 0);
+    for (size_t nt = 0; nt < g.nonterminalCount(); nt++) {
+        for (size_t t = 0; t < g.terminalCount; t++) follow[nt * g.terminalCount + t] = sets.follow[nt].contains(t);
+    }
+    exprSymbol = g.symbolId("Expr");
+    pushStartLabel = "push " + g.symbolNames[g.start];
+
+    tokenTerminals.fill(NO_SYMBOL);
+    for (Symbol t = 0; t < g.terminalCount; t++) {
+        matchLabels.push_back("match " + g.symbolNames[t] + " → pop");
+        if (t == g.endMarker) continue;
+        TokenType type;
+        if (!terminalTokenType(g.symbolNames[t], type)) {
+            throw std::runtime_error("Grammar: no token type for terminal '" + g.symbolNames[t] + "'");
+        }
+        tokenTerminals[type] = t;
+    }
+    terminalFlags.assign(g.symbolNames.size(), 0);
+    fill(terminalFlags.begin(), terminalFlags.begin() + g.terminalCount, 1);
+
+    for (size_t i = 0; i < g.productions.size(); i++) {
+        const GrammarProduction& gp = g.productions[i];
+        Parser::Production p;
+        p.lhs = gp.lhs;
+        p.first = static_cast<uint32_t>(productionSymbols.size());
+        p.length = static_cast<uint16_t>(gp.rhs.size());
+        productionSymbols.insert(productionSymbols.end(), gp.rhs.begin(), gp.rhs.end());
+
+        p.astFirst = static_cast<uint32_t>(astSymbols.size());
+        size_t next = 0;
+        for (const string& item : gp.items) {
+            AstAction action;
+            if (astActionNamed(item, action)) astSymbols.push_back(ACTION_SYMBOL + action);
+            else if (item.front() == '{') throw std::runtime_error("Grammar: unknown action " + item);
+            else astSymbols.push_back(gp.rhs[next++]);
+        }
+        p.astLength = static_cast<uint16_t>(astSymbols.size() - p.astFirst);
+
+        productions.push_back(p);
+        productionLabels.push_back("Expand " + g.productionText(i));
+    }
+}
+
+
+static const GeneratedGrammar& parserGrammar() {
+    static const GeneratedGrammar generated;
+    return generated;
+}
 
 
 void Parser::setupTable() {
-    for (auto k : {"IDENTIFIER", "print"}) 
-        parsingTable["S"][k] = {"Stmt", "S"};
-    parsingTable["S"]["$"] = {}; 
+    grammar = &parserGrammar();
+    const Grammar& g = grammar->grammar;
+    symbolNames = g.symbolNames.data();
+    terminalCount = g.terminalCount;
+    startSymbol = g.start;
+    endMarker = g.endMarker;
+    exprSymbol = grammar->exprSymbol;
+    productionSymbols = grammar->productionSymbols.data();
+    astSymbols = grammar->astSymbols.data();
+    productions = grammar->productions.data();
+    parsingTable = grammar->table.entries.data();
+    followTable = grammar->follow.data();
+    terminalFlags = grammar->terminalFlags.data();
+    tokenTerminals = grammar->tokenTerminals;
+}
 
-    for (auto k : {"IDENTIFIER", "print"}) 
-        parsingTable["S"][k] = {"Stmt", "S"};
-    parsingTable["S"]["$"] = {}; 
 
-    parsingTable["Stmt"]["IDENTIFIER"] = {"IDENTIFIER", "=", "Expr"};
-    parsingTable["Stmt"]["print"]      = {"print", "(", "Expr", ")"};
+const vector<string>& Parser::getSymbolNames() const { return grammar->grammar.symbolNames; }
+const vector<string>& Parser::getProductionLabels() const { return grammar->productionLabels; }
 
-    for (auto k : {"NUMBER", "IDENTIFIER", "FUNCTION", "("}) 
-        parsingTable["Expr"][k] = {"Term", "Expr'"};
 
-    parsingTable["Expr'"]["+"] = {"+", "Term", "Expr'"};
-    parsingTable["Expr'"]["-"] = {"-", "Term", "Expr'"};
-    for (auto k : {")", "$", "print", "IDENTIFIER"}) parsingTable["Expr'"][k] = {}; 
+template <typename TracePolicy>
+void Parser::pushSymbol(Symbol symbol) {
+    stack.push_back(symbol);
+    if constexpr (TracePolicy::records) {
+        traceTop = stackArena.push(traceTop, &symbolNames[symbol]);
+        if (recycleStackNodes && stackArena.size() > 2 * stack.size() + 4096) compactTraceStack();
+    }
+}
 
-    for (auto k : {"NUMBER", "IDENTIFIER", "FUNCTION", "("}) 
-        parsingTable["Term"][k] = {"Factor", "Term'"};
 
-    parsingTable["Term'"]["*"] = {"*", "Factor", "Term'"};
-    parsingTable["Term'"]["/"] = {"/", "Factor", "Term'"};
-    parsingTable["Term'"]["%"] = {"%", "Factor", "Term'"};
-    for (auto k : {"+", "-", ")", "$", "print", "IDENTIFIER"}) parsingTable["Term'"][k] = {};
+// Nobody holds on to old steps, so only the live stack needs to survive
+void Parser::compactTraceStack() {
+    vector<const string*> live;
+    for (const StackNode* n = traceTop; n; n = n->below) live.push_back(n->symbol);
 
-    parsingTable["Factor"]["NUMBER"]     = {"NUMBER"};
-    parsingTable["Factor"]["IDENTIFIER"] = {"IDENTIFIER"};
-    parsingTable["Factor"]["FUNCTION"] = {"FUNCTION", "(", "Expr", ")"};
-    parsingTable["Factor"]["("]          = {"(", "Expr", ")"};
-    
+    StackArena fresh;
+    traceTop = nullptr;
+    for (auto it = live.rbegin(); it != live.rend(); ++it) traceTop = fresh.push(traceTop, *it);
+    swap(stackArena, fresh);
+}
+
+
+template <typename TracePolicy>
+void Parser::popSymbol() {
+    stack.pop_back();
+    if constexpr (TracePolicy::records) traceTop = traceTop->below;
 }
 
-Token Parser::peek() {
+const Token& Parser::peek() const {
     if (pos < tokens.size()) {
         const Token& current = tokens[pos];
         if (tokens[pos].type == UNKNOWN && tokens[pos].value != "$") {
-            throw std::runtime_error("Syntax Error: Unknown token '" + tokens[pos].value + "'" + " at line " + std::to_string(current.line));
+            throw std::runtime_error("Syntax Error: Unknown token '" + tokens[pos].value + "'" + " at " + describePosition(current.offset));
         }
         return tokens[pos];
     }
-    int eofLine = tokens.empty() ? 1 : tokens.back().line;
-    return Token{ UNKNOWN, "$", eofLine };
+    return eof;
 }
 
 
-const vector<PDAAction>& Parser::getTrace() const { return trace; }
+// Like peek(), but never throws: the error being reported may be about it
+const Token& Parser::currentTokenForError() const {
+    return pos < tokens.size() ? tokens[pos] : eof;
+}
 
 
-void Parser::Push_pop(const string& nonTerminal, const vector<string>& production) {
-    string rhsStr = "";
-    if (production.empty()) {
-        rhsStr = "ε";
-    } else {
-        for (size_t i = 0; i < production.size(); ++i) {
-            rhsStr += production[i] + (i < production.size() - 1 ? " " : "");
+// Tokens pulled from a stream at a time. Small enough to stay in cache
+// while the parser works through them.
+static const size_t STREAM_WINDOW = 256;
+
+// Called once the parser has used up the window. Keeps the last token, which
+// error messages point at, and any expression the Pratt engine may give
+// back, and pulls the next tokens from the stream.
+void Parser::refillWindow() {
+    size_t drop = pos > 0 ? pos - 1 : 0;
+    if (pinnedToken != SIZE_MAX) drop = min(drop, pinnedToken - tokenBase);
+    window.erase(window.begin(), window.begin() + drop);
+    tokenBase += drop;
+    pos -= drop;
+
+    Token next(UNKNOWN, "", 0);
+    while (window.size() - pos < STREAM_WINDOW && stream->next(next)) window.push_back(std::move(next));
+    if (pos >= window.size()) {
+        streamEnded = true;
+        eof.offset = stream->endOffset();
+    }
+    tokens = TokenSpan(window);
+}
+
+
+void Parser::requireWholeInput() const {
+    if (stream) throw std::runtime_error("A streaming Parser can only validate");
+}
+
+
+vector<Symbol> Parser::productionRhs(size_t production) const {
+    const Production& p = productions[production];
+    return vector<Symbol>(productionSymbols + p.first, productionSymbols + p.first + p.length);
+}
+
+
+string Parser::describePosition(size_t offset) const {
+    return "line " + std::to_string(lines.lineAt(offset)) +
+           ", column " + std::to_string(lines.columnAt(offset));
+}
+
+
+const vector<PDAAction>& Parser::getTrace() const { return trace.getSteps(); }
+
+
+template <typename TracePolicy>
+void Parser::Push_pop(size_t production) {
+    const Production& p = productions[production];
+    if constexpr (TracePolicy::records) {
+        sink->onStep({traceTop, &peek(), &grammar->productionLabels[production],
+                         PDAOp::Expand, static_cast<uint16_t>(production), static_cast<uint32_t>(pos)});
+    }
+    popSymbol<TracePolicy>(); 
+
+    if constexpr (TracePolicy::buildsAst) {
+        const Symbol* rhs = astSymbols + p.astFirst;
+        for (size_t i = p.astLength; i > 0; --i) {
+            pushSymbol<TracePolicy>(rhs[i - 1]);
+            if (rhs[i - 1] >= ACTION_SYMBOL) actionStarts.push_back(static_cast<uint32_t>(pos));
         }
+        return;
     }
-    
-    string actionLabel = "Expand " + nonTerminal + " → " + rhsStr;
-    trace.push_back({stack, peek(), actionLabel});
-    stack.pop_back(); 
 
-    if (!production.empty()) {
-        for (auto it = production.rbegin(); it != production.rend(); ++it) {
-            stack.push_back(*it);
+    const Symbol* rhs = productionSymbols + p.first;
+    for (size_t i = p.length; i > 0; --i) {
+        pushSymbol<TracePolicy>(rhs[i - 1]);
+    }
+}
+
+
+// Every action's production starts with a terminal, so the input position
+// saved at expansion is the token the new node is named after
+void Parser::runAction(AstAction action) {
+    uint32_t start = actionStarts.back();
+    actionStarts.pop_back();
+
+    // Operands of a statement with errors may be missing; skip to its end
+    if (discardStatement) {
+        if (action == ActAssign || action == ActPrint) {
+            discardStatement = false;
+            values.clear();
         }
+        return;
     }
 
+    switch (action) {
+        case ActNumber:
+            values.push_back(ast->addNumber(start, strtod(tokens[start].value.c_str(), nullptr)));
+            break;
+        case ActVariable:
+            values.push_back(ast->add(AstKind::Variable, 0, start, NO_NODE, NO_NODE));
+            break;
+        case ActCall:
+            values.back() = ast->add(AstKind::Call, 0, start, values.back(), NO_NODE);
+            break;
+        case ActBinary: {
+            NodeIndex right = values.back();
+            values.pop_back();
+            values.back() = ast->add(AstKind::Binary, tokens[start].value[0], start, values.back(), right);
+            break;
+        }
+        case ActAssign:
+        case ActPrint: {
+            AstKind kind = action == ActAssign ? AstKind::Assign : AstKind::Print;
+            ast->appendStatement(ast->add(kind, 0, start, values.back(), NO_NODE));
+            values.pop_back();
+            break;
+        }
+    }
 }
 
-void Parser::match(const string& expectedTerminal) {
-    Token t = peek();
-    string actual = getLookaheadKey(t);
+template <typename TracePolicy>
+void Parser::match(Symbol expectedTerminal) {
+    const Token& t = peek();
 
-    if (actual == expectedTerminal) {
-        string actionLabel = "match " + actual + " → pop";
-        
-        stack.pop_back(); 
-        trace.push_back({stack, t, actionLabel});
+    if (lookaheadSymbol(t) == expectedTerminal) {
+        popSymbol<TracePolicy>(); 
+        if constexpr (TracePolicy::records) {
+            sink->onStep({traceTop, &t, &grammar->matchLabels[expectedTerminal],
+                             PDAOp::Match, expectedTerminal, static_cast<uint32_t>(pos)});
+        }
         
-        if (expectedTerminal != "$") pos++; 
+        if (expectedTerminal != endMarker) pos++; 
+        if constexpr (TracePolicy::recovers) inRecovery = false;
     } else {
         throw std::runtime_error(
-            "Syntax Error: Expected " + expectedTerminal + 
-            " at line " + std::to_string(previousToken.line)
+            "Syntax Error: Expected " + symbolNames[expectedTerminal] + 
+            " at " + describePosition(pos > 0 ? tokens[pos - 1].offset : 0)
         );
     }
 }
 
-// --- Grammar implementation ---
 void Parser::parse() {
     trace.clear();
+    parse(trace);
+}
+
+void Parser::parse(TraceSink& traceSink) {
+    requireWholeInput();
+    sink = &traceSink;
+    recycleStackNodes = !traceSink.retainsStack();
+    try {
+        run<TracedParse>();
+    } catch (const std::runtime_error& e) {
+        sink->onError({traceTop, &currentTokenForError(), &ERROR_LABEL, PDAOp::Error, 0, static_cast<uint32_t>(pos)}, e.what());
+        sink = nullptr;
+        throw;
+    }
+    sink = nullptr;
+}
+
+void Parser::validate() {
+    run<UntracedParse>();
+}
+
+void Parser::parse(Ast& tree) {
+    buildTree<AstParse>(tree);
+}
+
+void Parser::validate(vector<Diagnostic>& found) {
+    found.clear();
+    diagnostics = &found;
+    run<RecoveringParse>();
+    diagnostics = nullptr;
+}
+
+void Parser::parse(Ast& tree, vector<Diagnostic>& found) {
+    found.clear();
+    diagnostics = &found;
+    buildTree<RecoveringAstParse>(tree);
+    diagnostics = nullptr;
+}
+
+void Parser::parse(Ast& tree, vector<Diagnostic>& found, vector<StatementBoundary>& passed) {
+    passed.clear();
+    boundaries = &passed;
+    try {
+        parse(tree, found);
+    } catch (...) {
+        boundaries = nullptr;
+        throw;
+    }
+    boundaries = nullptr;
+}
+
+template <typename TracePolicy>
+void Parser::buildTree(Ast& tree) {
+    requireWholeInput();
+    tree.reset(tokens);
+    ast = &tree;
+    values.clear();
+    actionStarts.clear();
+    discardStatement = false;
+    try {
+        run<TracePolicy>();
+    } catch (...) {
+        ast = nullptr;
+        throw;
+    }
+    ast = nullptr;
+}
+
+
+// A terminal is missing: carry on as if it had been there. Only "$" is
+// never assumed; the extra input before it is skipped instead.
+template <typename TracePolicy>
+void Parser::recoverFromTerminal(Symbol expected) {
+    reportSyntaxError("Syntax Error: Expected " + symbolNames[expected]);
+    if (expected == endMarker) pos++;
+    else popSymbol<TracePolicy>();
+}
+
+
+// No production for this lookahead: skip input until the nonterminal can
+// start (keep it) or something that may follow it comes up (drop it). The
+// FOLLOW set of every nonterminal but S contains the statement starters
+// IDENTIFIER and print; FOLLOW(S) is only $, but S's table row covers both
+// starters. So at worst this resynchronizes at the next statement.
+template <typename TracePolicy>
+void Parser::recoverFromNonterminal(Symbol nonterminal) {
+    reportSyntaxError("Syntax Error at " + getLookaheadKey(currentTokenForError()));
+    size_t row = (nonterminal - terminalCount) * terminalCount;
+    while (true) {
+        if (stream && pos >= tokens.size() && !streamEnded) refillWindow();
+        if (pos < tokens.size() && tokens[pos].type == UNKNOWN && tokens[pos].value != "$") {
+            skipUnknownToken();
+            continue;
+        }
+        Symbol lookahead = lookaheadSymbol(currentTokenForError());
+        if (lookahead == endMarker || (lookahead != NO_SYMBOL && followTable[row + lookahead])) {
+            popSymbol<TracePolicy>();
+            return;
+        }
+        if (lookahead != NO_SYMBOL && parsingTable[row + lookahead] >= 0) return;
+        pos++;
+    }
+}
+
+
+// Unknown characters are lexical errors, each reported on its own
+void Parser::skipUnknownToken() {
+    addDiagnostic("Syntax Error: Unknown token '" + tokens[pos].value + "'");
+    if (ast) abandonStatement();
+    pos++;
+}
+
+
+void Parser::reportSyntaxError(const string& message) {
+    if (pos >= tokens.size() || lookaheadSymbol(tokens[pos]) == endMarker) errorAtEnd = true;
+    if (!inRecovery) addDiagnostic(message);
+    inRecovery = true;
+    if (ast) abandonStatement();
+}
+
+
+void Parser::addDiagnostic(const string& message) {
+    size_t offset = currentTokenForError().offset;
+    diagnostics->push_back({tokenBase + pos, offset, lines.lineAt(offset), lines.columnAt(offset), message});
+}
+
+
+// Drop the statement being built, if any: its pending {assign}/{print}
+// marker is still on the stack and will end the discarding
+void Parser::abandonStatement() {
+    for (Symbol s : stack) {
+        if (s == ACTION_SYMBOL + ActAssign || s == ACTION_SYMBOL + ActPrint) {
+            discardStatement = true;
+            return;
+        }
+    }
+    values.clear();
+}
+
+// --- Grammar implementation ---
+template <typename TracePolicy>
+void Parser::run() {
+    constexpr bool traced = TracePolicy::records;
     stack.clear();
+    stackArena.clear();
+    traceTop = nullptr;
     pos = 0;
+    inRecovery = false;
+    errorAtEnd = false;
+    if (stream) {
+        stream->rewind();
+        window.clear();
+        tokens = TokenSpan();
+        tokenBase = 0;
+        streamEnded = false;
+    }
 
     // Initial sequence
-    stack.push_back("$");
-    trace.push_back({stack, peek(), "push $"});
-    stack.push_back("S");
-    trace.push_back({stack, peek(), "push S"});
+    pushSymbol<TracePolicy>(endMarker);
+    if constexpr (traced) sink->onStep({traceTop, &peek(), &PUSH_END_LABEL, PDAOp::Push, endMarker, 0});
+    pushSymbol<TracePolicy>(startSymbol);
+    if constexpr (traced) sink->onStep({traceTop, &peek(), &grammar->pushStartLabel, PDAOp::Push, startSymbol, 0});
 
-    try {
-        while (!stack.empty()) {
-            string top = stack.back();
-            string key = getLookaheadKey(peek());
-
-            // Check if top is a terminal
-            bool isTerminal = (top == "IDENTIFIER" || top == "NUMBER" || top == "=" || 
-                               top == "+" || top == "-" || top == "*" || top == "/" || top == "FUNCTION" ||
-                               top == "%" || top == "(" || top == ")" || top == "print" || top == "$");
-
-            if (top == "$" && key == "$") {
-                match("$");
-                trace.push_back({stack, peek(), "ACCEPTED"});
-                break;
+    while (!stack.empty()) {
+        if (stream && pos >= tokens.size() && !streamEnded) refillWindow();
+        Symbol top = stack.back();
+        if constexpr (TracePolicy::buildsAst) {
+            if (top >= ACTION_SYMBOL) {
+                popSymbol<TracePolicy>();
+                runAction(static_cast<AstAction>(top - ACTION_SYMBOL));
+                continue;
+            }
+        }
+        if constexpr (TracePolicy::recovers) {
+            if (pos < tokens.size() && tokens[pos].type == UNKNOWN && tokens[pos].value != "$") {
+                skipUnknownToken();
+                continue;
             }
+        }
+        if constexpr (!traced) {
+            if (top == exprSymbol && engine == ExpressionEngine::Pratt && parseExpression<TracePolicy>()) continue;
+        }
+        Symbol lookahead = lookaheadSymbol(peek());
+
+        if (top == endMarker && lookahead == endMarker) {
+            match<TracePolicy>(endMarker);
+            if constexpr (traced) {
+                sink->onStep({traceTop, &peek(), &ACCEPT_LABEL, PDAOp::Accept, 0, static_cast<uint32_t>(pos)});
+            }
+            break;
+        }
 
-            if (isTerminal) {
-                if (top == "FUNCTION" && peek().type == FUNCTION) {
-                    match("FUNCTION");
-                } else if (top == key) {
-                    match(top);
-                } else {
-                    throw std::runtime_error("Syntax Error: Expected " + top);
-                }
-            } else if (parsingTable.count(top) && parsingTable[top].count(key)) {
-                Push_pop(top, parsingTable[top][key]);
+        if (terminalFlags[top]) {
+            if (top == lookahead) {
+                match<TracePolicy>(top);
+            } else if constexpr (TracePolicy::recovers) {
+                recoverFromTerminal<TracePolicy>(top);
             } else {
-                throw std::runtime_error("Syntax Error at " + key);
+                throw std::runtime_error("Syntax Error: Expected " + symbolNames[top]);
             }
+            continue;
         }
-    } catch (const std::runtime_error& e) {
-        //trace.push_back({stack, peek(), "ERROR: " + string(e.what())});
-        throw;
+
+        if constexpr (TracePolicy::recovers) {
+            if (boundaries && top == startSymbol && stack.size() == 2 && !inRecovery) {
+                boundaries->push_back({static_cast<uint32_t>(pos), ast ? static_cast<NodeIndex>(ast->size()) : 0});
+            }
+        }
+        int16_t production = lookahead == NO_SYMBOL ? -1
+            : parsingTable[(top - terminalCount) * terminalCount + lookahead];
+        if (production < 0) {
+            if constexpr (TracePolicy::recovers) {
+                recoverFromNonterminal<TracePolicy>(top);
+                continue;
+            }
+            throw std::runtime_error("Syntax Error at " + getLookaheadKey(peek()));
+        }
+        Push_pop<TracePolicy>(static_cast<size_t>(production));
     }
 }
 
 
-string Parser::getLookaheadKey(Token t) {
+// --- Pratt expression engine ---
+
+// Binary operators by token type: binding power (higher binds tighter, 0 =
+// not an operator). All of them are left-associative.
+static const array<uint8_t, UNKNOWN + 1> INFIX_POWER = [] {
+    array<uint8_t, UNKNOWN + 1> power{};
+    power[PLUS] = power[MINUS] = 10;
+    power[MULTIPLY] = power[DIVIDE] = power[MOD] = 20;
+    return power;
+}();
+
+// Deeper nesting is left to the PDA, whose stack is not the call stack
+static const size_t MAX_PRATT_DEPTH = 512;
+
+
+// Parses the expression for the Expr on top of the stack, as the PDA would
+// have. Anything the PDA would report an error for, or mid-statement
+// recovery, makes it put the input and tree back and return false, so the
+// PDA parses the expression itself and produces the usual diagnostics.
+template <typename TracePolicy>
+bool Parser::parseExpression() {
+    if (inRecovery || discardStatement) return false;
+    size_t start = pos;
+    size_t nodes = ast ? ast->size() : 0;
+    size_t constants = ast ? ast->constantCount() : 0;
+
+    pinnedToken = tokenBase + start;
+    NodeIndex value = NO_NODE;
+    bool parsed = prattExpression<TracePolicy>(0, 0, value);
+    size_t pinned = pinnedToken;
+    pinnedToken = SIZE_MAX;
+
+    if (!parsed) {
+        pos = pinned - tokenBase;
+        if (ast) ast->truncate(nodes, constants);
+        return false;
+    }
+    popSymbol<TracePolicy>();
+    if constexpr (TracePolicy::buildsAst) values.push_back(value);
+    return true;
+}
+
+
+template <typename TracePolicy>
+bool Parser::prattExpression(int minPower, size_t depth, NodeIndex& value) {
+    if (depth > MAX_PRATT_DEPTH) return false;
+    const Token* t = prattToken();
+    if (!t) return false;
+
+    // Operand, nodes built in the same order as the PDA's actions
+    uint32_t at = static_cast<uint32_t>(pos);
+    switch (t->type) {
+        case NUMBER:
+            pos++;
+            if constexpr (TracePolicy::buildsAst) value = ast->addNumber(at, strtod(t->value.c_str(), nullptr));
+            break;
+        case IDENTIFIER:
+            pos++;
+            if constexpr (TracePolicy::buildsAst) value = ast->add(AstKind::Variable, 0, at, NO_NODE, NO_NODE);
+            break;
+        case FUNCTION: {
+            pos++;
+            NodeIndex argument = NO_NODE;
+            if (!prattExpect(LPAREN) || !prattExpression<TracePolicy>(0, depth + 1, argument) || !prattExpect(RPAREN)) return false;
+            if constexpr (TracePolicy::buildsAst) value = ast->add(AstKind::Call, 0, at, argument, NO_NODE);
+            break;
+        }
+        case LPAREN:
+            pos++;
+            if (!prattExpression<TracePolicy>(0, depth + 1, value) || !prattExpect(RPAREN)) return false;
+            break;
+        default:
+            return false;
+    }
+
+    while (true) {
+        t = prattToken();
+        uint8_t power = t && t->type != UNKNOWN ? INFIX_POWER[t->type] : 0;
+        if (power == 0) {
+            // Where the expression ends the PDA reduces Expr' and Term' to
+            // ε, which it only does on a token that may follow Expr
+            Symbol next = t ? lookaheadSymbol(*t) : endMarker;
+            return next != NO_SYMBOL && followTable[(exprSymbol - terminalCount) * terminalCount + next];
+        }
+        if (power < minPower) return true;
+
+        uint32_t op = static_cast<uint32_t>(pos++);
+        char symbol = t->value[0];
+        NodeIndex right = NO_NODE;
+        if (!prattExpression<TracePolicy>(power + 1, depth + 1, right)) return false;
+        if constexpr (TracePolicy::buildsAst) value = ast->add(AstKind::Binary, symbol, op, value, right);
+    }
+}
+
+
+bool Parser::prattExpect(TokenType type) {
+    const Token* t = prattToken();
+    if (!t || t->type != type) return false;
+    pos++;
+    return true;
+}
+
+
+// The token at pos, or nullptr at the end of input
+const Token* Parser::prattToken() {
+    if (stream && pos >= tokens.size() && !streamEnded) refillWindow();
+    return pos < tokens.size() ? &tokens[pos] : nullptr;
+}
+
+
+Symbol Parser::lookaheadSymbol(const Token& t) const {
+    if (t.type != UNKNOWN) return tokenTerminals[t.type];
+    // peek() only lets the end-of-input token through as UNKNOWN
+    return t.value == "$" ? endMarker : NO_SYMBOL;
+}
+
+
+// Lookahead spelled as a grammar symbol, for error messages
+string Parser::getLookaheadKey(const Token& t) const {
     if (t.value == "$") return "$";
     if (t.value == "%") return "%";
     
@@ -4,32 +4,215 @@
 #include <vector>
 #include <string>
 #include <map>
+#include <cstdint>
+#include <array>
 #include "lexical.h"
 #include "pda_tracer.h"
+#include "ast.h"
+#include "grammar.h"
 
 using namespace std;
 
+struct GeneratedGrammar;
+
+// Tree-building actions ride on the parse stack as marker symbols from
+// ACTION_SYMBOL up; they run when popped and never show up in a trace.
+static const Symbol ACTION_SYMBOL = 0xFF00;
+enum AstAction : uint8_t { ActNumber, ActVariable, ActCall, ActBinary, ActAssign, ActPrint };
+
+// Grammar items the parsers know: the token type a terminal name such as
+// "IDENTIFIER" or "+" matches, and the action an item such as "{binary}"
+// names. Both return false for anything else.
+bool terminalTokenType(const string& terminal, TokenType& type);
+bool astActionNamed(const string& item, AstAction& action);
+
+// Parse loop policies. The visualizer needs a PDAAction per step; headless
+// validation only needs accept/reject, and the trace is most of the cost.
+// Recovering parses record each syntax error and carry on.
+template <bool Records, bool BuildsAst, bool Recovers>
+struct ParsePolicy {
+    static constexpr bool records = Records;
+    static constexpr bool buildsAst = BuildsAst;
+    static constexpr bool recovers = Recovers;
+};
+typedef ParsePolicy<true, false, false>  TracedParse;
+typedef ParsePolicy<false, false, false> UntracedParse;
+typedef ParsePolicy<false, true, false>  AstParse;
+typedef ParsePolicy<false, false, true>  RecoveringParse;
+typedef ParsePolicy<false, true, true>   RecoveringAstParse;
+
+// How untraced parses read expressions. The PDA expands Expr, Expr', Term,
+// Term' and Factor on its stack, several steps per operator; the Pratt
+// engine reads a whole expression in one pass by operator precedence. Both
+// build the same trees and report the same errors.
+enum class ExpressionEngine : uint8_t { Pda, Pratt };
+
+// One syntax error found by a recovering parse
+struct Diagnostic {
+    size_t tokenIndex;      // where it was detected; tokens.size() = end of input
+    size_t offset;          // byte offset in the source
+    int line;
+    int column;
+    string message;
+};
+
+// A point between top-level statements after which the parse depends only
+// on the input from there on: S is about to be expanded with nothing but $
+// below it and no syntax error pending. node is the tree size at that point,
+// so the nodes of the statements between two boundaries form one range.
+struct StatementBoundary {
+    uint32_t token;
+    NodeIndex node;
+};
+
+// All parse state lives in the instance, so separate Parsers may run on
+// separate threads at once. One Parser must not be used from two threads.
 class Parser {
 public:
-    Parser(const vector<Token>& tokens);
-    void parse();                          // Entry point (S)
-    const vector<PDAAction>& getTrace() const;
+    // The parser reads the caller's tokens in place; keep them alive and
+    // unchanged for as long as the Parser and its trace are in use
+    Parser(TokenSpan tokens, const LineIndex& lines = LineIndex());
+    Parser(vector<Token>&& tokens, const LineIndex& lines = LineIndex()) = delete;
+
+    // Pulls tokens from the stream through a small window as it goes, so
+    // lexing and parsing interleave and memory use does not grow with the
+    // input. Only validate() and validate(diagnostics) work this way: trees
+    // and traces refer back into the whole token list. Each call rewinds
+    // the source.
+    explicit Parser(TokenSource& stream, const LineIndex& lines = LineIndex());
+
+    Parser(const Parser&) = delete;             // trace steps point into this object
+    Parser& operator=(const Parser&) = delete;
+
+    void parse();                          // Entry point (S), records the trace
+    void parse(TraceSink& sink);           // Streams the trace to sink instead
+    void validate();                       // Same checks and errors, no trace
+    void parse(Ast& ast);                  // No trace, builds the syntax tree
+
+    // Panic-mode recovery: instead of stopping at the first error, record it
+    // and resynchronize, so one pass reports every error. Statements with
+    // errors are left out of the tree.
+    void validate(vector<Diagnostic>& diagnostics);
+    void parse(Ast& ast, vector<Diagnostic>& diagnostics);
+    void parse(Ast& ast, vector<Diagnostic>& diagnostics, vector<StatementBoundary>& boundaries);
+
+    // Traced parses always run the PDA, which is what the visualizer shows
+    void setExpressionEngine(ExpressionEngine e) { engine = e; }
+    ExpressionEngine expressionEngine() const { return engine; }
+
+    // Whether the last recovering parse ran into an error at end of input,
+    // reported or not. For a caller that parsed only part of a program, it
+    // means the part ended inside a statement.
+    bool errorAtEndOfInput() const { return errorAtEnd; }
+    const vector<PDAAction>& getTrace() const;   // steps of the last parse()
+
+    // Grammar and input as the trace refers to them, for serializing it
+    const vector<string>& getSymbolNames() const;
+    const vector<string>& getProductionLabels() const;
+    vector<Symbol> productionRhs(size_t production) const;
+    TokenSpan getTokens() const { return tokens; }    // streaming: the current window
+    const Token& endOfInput() const { return eof; }
 
 private:
-    vector<Token> tokens;
+    friend struct GeneratedGrammar;
+
+    // Right-hand sides live back to back in productionSymbols; the same
+    // right-hand sides with tree-building actions in astSymbols
+    struct Production {
+        Symbol lhs;
+        uint16_t length;
+        uint32_t first;
+        uint32_t astFirst;
+        uint16_t astLength;
+    };
+
+    TokenSpan tokens;
+    Token eof;                   // stands in once the input runs out
+    LineIndex lines;
     size_t pos = 0;
 
-    vector<string> stack; 
-    vector<PDAAction> trace;     
+    // Streaming input: tokens is a view of window, which holds the input
+    // from tokenBase on
+    TokenSource* stream = nullptr;
+    vector<Token> window;
+    size_t tokenBase = 0;
+    bool streamEnded = false;
+
+    vector<Symbol> stack; 
+    MemoryTraceSink trace;
+    TraceSink* sink = nullptr;
+
+    // Traced mode mirrors the stack persistently so steps can share it
+    StackArena stackArena;
+    const StackNode* traceTop = nullptr;
+    bool recycleStackNodes = false;
+
+    // Tree building: operands waiting for their parent, and the input
+    // position at which each pending action's production was expanded
+    Ast* ast = nullptr;
+    vector<NodeIndex> values;
+    vector<uint32_t> actionStarts;
+    bool discardStatement = false;
+
+    // Error recovery: no new syntax error is reported until a token has been
+    // matched since the last one, which keeps one mistake to one diagnostic
+    vector<Diagnostic>* diagnostics = nullptr;
+    bool inRecovery = false;
+    bool errorAtEnd = false;
+    vector<StatementBoundary>* boundaries = nullptr;
+
+    // Pratt engine. An expression it cannot parse is handed back to the
+    // PDA, so it keeps the tokens from pinnedToken on (streaming) and rolls
+    // the tree back.
+    ExpressionEngine engine = ExpressionEngine::Pda;
+    Symbol exprSymbol = NO_SYMBOL;
+    size_t pinnedToken = SIZE_MAX;
+
+    // Tables for the grammar in grammar.cpp. They are generated once per
+    // process and shared by every Parser; setupTable points into them.
+    const GeneratedGrammar* grammar = nullptr;
+    const string* symbolNames = nullptr;
+    size_t terminalCount = 0;
+    Symbol startSymbol = NO_SYMBOL;
+    const Symbol* productionSymbols = nullptr;
+    const Symbol* astSymbols = nullptr;
+    const Production* productions = nullptr;
+    const int16_t* parsingTable = nullptr;     // [nonterminal][terminal] -> production, -1 = error
+    const uint8_t* followTable = nullptr;      // [nonterminal][terminal] -> in FOLLOW
+
+    // Per-token classification
+    const uint8_t* terminalFlags = nullptr;        // by Symbol
+    array<Symbol, UNKNOWN + 1> tokenTerminals;     // by TokenType
+    Symbol endMarker = NO_SYMBOL;
 
     // PDA helpers
     void setupTable();  
-    void match(const string& expectedTerminal);
-    void Push_pop(const string& nonTerminal, const vector<string>& production);
+    void refillWindow();
+    void requireWholeInput() const;
+    template <typename TracePolicy> void run();
+    template <typename TracePolicy> void match(Symbol expectedTerminal);
+    template <typename TracePolicy> void Push_pop(size_t production);
+    template <typename TracePolicy> void pushSymbol(Symbol symbol);
+    template <typename TracePolicy> void popSymbol();
+    void runAction(AstAction action);
+    template <typename TracePolicy> void buildTree(Ast& ast);
+    template <typename TracePolicy> void recoverFromTerminal(Symbol expected);
+    template <typename TracePolicy> void recoverFromNonterminal(Symbol nonterminal);
+    template <typename TracePolicy> bool parseExpression();
+    template <typename TracePolicy> bool prattExpression(int minPower, size_t depth, NodeIndex& value);
+    bool prattExpect(TokenType type);
+    const Token* prattToken();
+    void skipUnknownToken();
+    void reportSyntaxError(const string& message);
+    void addDiagnostic(const string& message);
+    void abandonStatement();
+    void compactTraceStack();
+    const Token& currentTokenForError() const;
 
-    Token peek();
-    string getLookaheadKey(Token t);
-    map<string, map<string, vector<string>>> parsingTable;
+    const Token& peek() const;
+    Symbol lookaheadSymbol(const Token& t) const;
+    string getLookaheadKey(const Token& t) const;
+    string describePosition(size_t offset) const;
 };
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,93 @@
+#include <stdexcept>
+#include "token_pipeline.h"
+
+using namespace std;
+
+// Tokens per slot: enough that handing a slot over is rare next to lexing
+// it, few enough that the parser starts early and the ring stays in cache
+static const size_t BATCH_TOKENS = 512;
+
+
+TokenPipeline::TokenPipeline(shared_ptr<const CompiledLexer> l, const string& t)
+    : lexer(std::move(l)), text(t) {
+    for (vector<Token>& slot : ring) slot.reserve(BATCH_TOKENS);
+    lexerThread = thread(&TokenPipeline::produce, this);
+}
+
+
+TokenPipeline::~TokenPipeline() {
+    cancelled.store(true, memory_order_relaxed);
+    lexerThread.join();
+}
+
+
+void TokenPipeline::produce() {
+    try {
+        TokenStream source(*lexer, text);
+        Token token(UNKNOWN, "", 0);
+        bool more = true;
+        for (size_t slot = 0; more; slot++) {
+            // Backpressure: the slot is free once the parser is done with
+            // the batch that was in it a whole ring ago
+            while (slot >= consumed.load(memory_order_acquire) + SLOTS) {
+                if (cancelled.load(memory_order_relaxed)) return;
+                producerStalls.fetch_add(1, memory_order_relaxed);
+                this_thread::yield();
+            }
+
+            vector<Token>& batch = ring[slot % SLOTS];
+            batch.clear();
+            while (batch.size() < BATCH_TOKENS && (more = source.next(token))) batch.push_back(std::move(token));
+            if (batch.empty()) break;
+            produced.store(slot + 1, memory_order_release);
+            if (cancelled.load(memory_order_relaxed)) return;
+        }
+    } catch (...) {
+        lexerError = current_exception();
+    }
+    finished.store(true, memory_order_release);
+}
+
+
+bool TokenPipeline::next(Token& token) {
+    while (true) {
+        size_t slot = consumed.load(memory_order_relaxed);
+        if (slot < available || slot < (available = produced.load(memory_order_acquire))) {
+            vector<Token>& batch = ring[slot % SLOTS];
+            if (readIndex < batch.size()) {
+                token = std::move(batch[readIndex++]);
+                lastEnd = token.offset + token.lexeme.size();
+                tokens++;
+                return true;
+            }
+            readIndex = 0;
+            consumed.store(slot + 1, memory_order_release);
+            continue;
+        }
+
+        // The last batch is published before finished is set, so look once
+        // more after seeing it
+        if (finished.load(memory_order_acquire)) {
+            if (slot < produced.load(memory_order_acquire)) continue;
+            if (lexerError) rethrow_exception(lexerError);
+            return false;
+        }
+        consumerStalls.fetch_add(1, memory_order_relaxed);
+        this_thread::yield();
+    }
+}
+
+
+void TokenPipeline::rewind() {
+    if (tokens > 0) throw std::runtime_error("A token pipeline can be read only once");
+}
+
+
+PipelineStats TokenPipeline::stats() const {
+    PipelineStats s;
+    s.tokens = tokens;
+    s.batches = consumed.load(memory_order_relaxed) + (readIndex > 0 ? 1 : 0);
+    s.producerStalls = producerStalls.load(memory_order_relaxed);
+    s.consumerStalls = consumerStalls.load(memory_order_relaxed);
+    return s;
+}
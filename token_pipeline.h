@@ -0,0 +1,79 @@
+#ifndef TOKEN_PIPELINE_H
+#define TOKEN_PIPELINE_H
+
+#include <array>
+#include <atomic>
+#include <exception>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include "lexical.h"
+
+using namespace std;
+
+struct PipelineStats {
+    size_t tokens = 0;
+    size_t batches = 0;
+    size_t producerStalls = 0;      // waits for the parser to free a slot
+    size_t consumerStalls = 0;      // waits for the lexer to fill one
+};
+
+// Lexes a text on a thread of its own, so a Parser reading from it runs on
+// another core at the same time:
+//
+//     TokenPipeline tokens(lexer, text);
+//     Parser(tokens, lines).validate(diagnostics);
+//
+// Tokens travel in batches through a fixed ring of slots. Each slot index is
+// written by one side only (single producer, single consumer), so the two
+// threads hand slots over with an acquire/release pair and no lock. When the
+// ring is full the lexer waits for the parser, which bounds memory.
+//
+// An exception on the lexer thread is rethrown from next(). Destroying the
+// pipeline stops the lexer, also when the parser gave up halfway. The text
+// must outlive the pipeline, and it can be read only once.
+class TokenPipeline : public TokenSource {
+public:
+    TokenPipeline(shared_ptr<const CompiledLexer> lexer, const string& text);
+    ~TokenPipeline();
+
+    TokenPipeline(const TokenPipeline&) = delete;
+    TokenPipeline& operator=(const TokenPipeline&) = delete;
+
+    bool next(Token& token) override;
+    void rewind() override;                   // only before the first token
+    size_t endOffset() const override { return lastEnd; }
+
+    PipelineStats stats() const;
+
+private:
+    static const size_t SLOTS = 8;
+
+    void produce();
+
+    shared_ptr<const CompiledLexer> lexer;
+    const string& text;
+    array<vector<Token>, SLOTS> ring;
+
+    // Slots filled and slots freed so far. Each has one writer and lives on
+    // its own cache line, so the two sides only meet on a hand-over.
+    alignas(64) atomic<size_t> produced{0};
+    alignas(64) atomic<size_t> consumed{0};
+    atomic<bool> finished{false};
+    atomic<bool> cancelled{false};
+    exception_ptr lexerError;                 // set before finished
+
+    // Consumer side
+    size_t available = 0;                     // produced, as last seen
+    size_t readIndex = 0;                     // in the current slot
+    size_t lastEnd = 0;
+    size_t tokens = 0;
+
+    atomic<size_t> producerStalls{0};
+    atomic<size_t> consumerStalls{0};
+
+    thread lexerThread;                       // last, so it starts after the rest
+};
+
+#endif
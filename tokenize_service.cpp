@@ -0,0 +1,154 @@
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include "tokenize_service.h"
+
+using namespace std;
+
+// Documents per queued range: small enough to balance, large enough that
+// queue locking stays off the profile for formula-sized inputs
+static const size_t RANGE_SIZE = 16;
+
+
+TokenizeService::TokenizeService(shared_ptr<const CompiledLexer> l, unsigned threadCount)
+    : lexer(std::move(l)) {
+    startWorkers(threadCount);
+}
+
+
+TokenizeService::TokenizeService(const TokenRuleWatcher& w, unsigned threadCount) : watcher(&w) {
+    startWorkers(threadCount);
+}
+
+
+void TokenizeService::startWorkers(unsigned threadCount) {
+    if (threadCount == 0) threadCount = 1;
+    for (unsigned i = 0; i < threadCount; i++) workers.push_back(make_unique<Worker>());
+    for (unsigned i = 0; i < threadCount; i++) threads.emplace_back(&TokenizeService::workerLoop, this, i);
+}
+
+
+TokenizeService::~TokenizeService() {
+    {
+        lock_guard<mutex> lock(batchMutex);
+        shuttingDown = true;
+    }
+    batchStarted.notify_all();
+    for (thread& t : threads) t.join();
+}
+
+
+BatchStats TokenizeService::tokenizeBatch(const vector<string>& inputs, vector<DocumentTokens>& results) {
+    lock_guard<mutex> serialized(callMutex);
+    auto started = chrono::steady_clock::now();
+
+    placements.assign(inputs.size(), Placement{0, 0, 0});
+    for (auto& w : workers) {
+        w->output.clear();
+        w->tokens = 0;
+    }
+
+    // Deal ranges round-robin so every worker starts with local work
+    size_t next = 0;
+    for (size_t first = 0; first < inputs.size(); first += RANGE_SIZE, next++) {
+        Worker& w = *workers[next % workers.size()];
+        w.queue.push_back({first, min(first + RANGE_SIZE, inputs.size())});
+    }
+
+    {
+        unique_lock<mutex> lock(batchMutex);
+        batchInputs = &inputs;
+        batchLexer = watcher ? watcher->current() : lexer;
+        busyWorkers = workers.size();
+        batchGeneration++;
+        batchStarted.notify_all();
+        batchFinished.wait(lock, [&] { return busyWorkers == 0; });
+        batchInputs = nullptr;
+        batchLexer.reset();
+    }
+
+    // Buffers are final now, so spans can point into them
+    BatchStats stats;
+    results.resize(inputs.size());
+    for (size_t doc = 0; doc < inputs.size(); doc++) {
+        const Placement& p = placements[doc];
+        results[doc] = { workers[p.worker]->output.data() + p.offset, p.count };
+        stats.bytes += inputs[doc].size();
+    }
+    for (auto& w : workers) stats.tokens += w->tokens;
+    stats.documents = inputs.size();
+    stats.seconds = chrono::duration<double>(chrono::steady_clock::now() - started).count();
+    return stats;
+}
+
+
+void TokenizeService::workerLoop(size_t self) {
+    size_t seenGeneration = 0;
+    while (true) {
+        {
+            unique_lock<mutex> lock(batchMutex);
+            batchStarted.wait(lock, [&] { return shuttingDown || batchGeneration != seenGeneration; });
+            if (shuttingDown) return;
+            seenGeneration = batchGeneration;
+        }
+
+        Range range;
+        while (takeRange(self, range)) {
+            for (size_t doc = range.first; doc < range.last; doc++) {
+                tokenizeDocument(*workers[self], doc);
+                placements[doc].worker = self;
+            }
+        }
+
+        lock_guard<mutex> lock(batchMutex);
+        if (--busyWorkers == 0) batchFinished.notify_one();
+    }
+}
+
+
+// Own queue from the back, other queues from the front. No work is added
+// during a batch, so finding every queue empty means this worker is done.
+bool TokenizeService::takeRange(size_t self, Range& range) {
+    {
+        Worker& own = *workers[self];
+        lock_guard<mutex> lock(own.queueMutex);
+        if (!own.queue.empty()) {
+            range = own.queue.back();
+            own.queue.pop_back();
+            return true;
+        }
+    }
+    for (size_t k = 1; k < workers.size(); k++) {
+        Worker& victim = *workers[(self + k) % workers.size()];
+        lock_guard<mutex> lock(victim.queueMutex);
+        if (!victim.queue.empty()) {
+            range = victim.queue.front();
+            victim.queue.pop_front();
+            return true;
+        }
+    }
+    return false;
+}
+
+
+void TokenizeService::tokenizeDocument(Worker& worker, size_t doc) {
+    const string& text = (*batchInputs)[doc];
+    const CompiledLexer& lexer = *batchLexer;
+    const DFATable& table = lexer.table;
+    size_t first = worker.output.size();
+    size_t pos = 0;
+
+    while (pos < text.size()) {
+        ScanResult r = scanNextToken(table, lexer.keywords, text, pos);
+        if (r.foundToken) {
+            worker.output.push_back(std::move(r.token));
+        } else if (r.newPosition > pos && !isspace(static_cast<unsigned char>(text[r.newPosition - 1]))) {
+            worker.output.push_back(Token{UNKNOWN, text.substr(r.newPosition - 1, 1), r.newPosition - 1});
+        }
+        pos = r.newPosition;
+    }
+
+    placements[doc].offset = first;
+    placements[doc].count = worker.output.size() - first;
+    worker.tokens += placements[doc].count;
+}
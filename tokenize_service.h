@@ -0,0 +1,97 @@
+#ifndef TOKENIZE_SERVICE_H
+#define TOKENIZE_SERVICE_H
+
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "lexical.h"
+#include "rule_watcher.h"
+
+using namespace std;
+
+struct BatchStats {
+    size_t documents = 0;
+    size_t bytes = 0;
+    size_t tokens = 0;
+    double seconds = 0.0;
+
+    double documentsPerSecond() const { return seconds > 0 ? documents / seconds : 0.0; }
+    double bytesPerSecond() const { return seconds > 0 ? bytes / seconds : 0.0; }
+};
+
+// Tokens of one document. Points into a worker's output buffer, which is
+// reused by the next batch, so copy out anything that must outlive it.
+typedef TokenSpan DocumentTokens;
+
+// Tokenizes many independent inputs at once on a fixed pool of workers that
+// all read the same immutable CompiledLexer table. Documents are handed out
+// in small ranges; a worker that runs dry steals ranges from the others.
+// Unrecognized characters become UNKNOWN tokens, as in the Lexical tab.
+//
+// Built on a TokenRuleWatcher, the service takes the watcher's current()
+// lexer at the start of every batch, so a reloaded spec applies from the next
+// batch on and a batch never mixes two lexers.
+//
+// One batch runs at a time; concurrent tokenizeBatch calls are serialized.
+class TokenizeService {
+public:
+    explicit TokenizeService(shared_ptr<const CompiledLexer> lexer,
+                             unsigned threadCount = thread::hardware_concurrency());
+    explicit TokenizeService(const TokenRuleWatcher& watcher,
+                             unsigned threadCount = thread::hardware_concurrency());
+    ~TokenizeService();
+
+    TokenizeService(const TokenizeService&) = delete;
+    TokenizeService& operator=(const TokenizeService&) = delete;
+
+    BatchStats tokenizeBatch(const vector<string>& inputs, vector<DocumentTokens>& results);
+
+    size_t threadCount() const { return workers.size(); }
+
+private:
+    struct Range {
+        size_t first;
+        size_t last;
+    };
+
+    struct Placement {
+        size_t worker;
+        size_t offset;
+        size_t count;
+    };
+
+    struct Worker {
+        mutex queueMutex;
+        deque<Range> queue;
+        vector<Token> output;      // reused across batches
+        size_t tokens = 0;
+    };
+
+    void workerLoop(size_t self);
+    bool takeRange(size_t self, Range& range);
+    void startWorkers(unsigned threadCount);
+    void tokenizeDocument(Worker& worker, size_t doc);
+
+    shared_ptr<const CompiledLexer> lexer;    // fixed, unless there is a watcher
+    const TokenRuleWatcher* watcher = nullptr;
+    vector<unique_ptr<Worker>> workers;
+    vector<thread> threads;
+
+    mutex callMutex;
+    mutex batchMutex;
+    condition_variable batchStarted;
+    condition_variable batchFinished;
+    size_t batchGeneration = 0;
+    size_t busyWorkers = 0;
+    bool shuttingDown = false;
+
+    const vector<string>* batchInputs = nullptr;
+    shared_ptr<const CompiledLexer> batchLexer;
+    vector<Placement> placements;
+};
+
+#endif
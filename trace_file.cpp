@@ -0,0 +1,371 @@
+#include <cstring>
+#include <stdexcept>
+#include "trace_file.h"
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+static const char TRACE_MAGIC[4] = { 'P', 'D', 'A', 'T' };
+static const uint32_t TRACE_VERSION = 1;
+
+struct TraceStringRef {
+    uint32_t offset;
+    uint32_t length;
+};
+
+struct TraceProductionRecord {
+    uint32_t rhsFirst;
+    uint16_t rhsLength;
+    uint16_t reserved;
+    TraceStringRef label;
+};
+
+struct TraceTokenRecord {
+    uint32_t type;
+    uint32_t reserved;
+    uint64_t offset;
+    TraceStringRef value;
+};
+
+struct TraceStepRecord {
+    uint8_t op;
+    uint8_t reserved;
+    uint16_t arg;
+    uint32_t tokenIndex;
+};
+
+
+// Stack change between two consecutive steps. An Expand step shows the stack
+// before expanding, so its production is applied when the next step arrives;
+// a Match step shows the stack after popping its terminal.
+static void applyStep(vector<Symbol>& stack, const vector<vector<Symbol>>& rhs,
+                      bool hasPendingExpand, uint16_t pendingExpand, PDAOp op, uint16_t arg) {
+    if (hasPendingExpand) {
+        stack.pop_back();
+        const vector<Symbol>& production = rhs[pendingExpand];
+        stack.insert(stack.end(), production.rbegin(), production.rend());
+    }
+    if (op == PDAOp::Match) stack.pop_back();
+    else if (op == PDAOp::Push) stack.push_back(arg);
+}
+
+
+template <typename T>
+static void writeRaw(ofstream& out, const T* items, size_t count) {
+    out.write(reinterpret_cast<const char*>(items), static_cast<streamsize>(sizeof(T) * count));
+}
+
+
+static uint64_t alignOutput(ofstream& out) {
+    uint64_t at = static_cast<uint64_t>(out.tellp());
+    static const char zeros[8] = {};
+    if (at % 8) {
+        out.write(zeros, static_cast<streamsize>(8 - at % 8));
+        at += 8 - at % 8;
+    }
+    return at;
+}
+
+
+TraceFileWriter::TraceFileWriter(const string& p, const Parser& parser, uint32_t interval)
+    : out(p, ios::binary | ios::trunc), path(p), keyframeInterval(interval ? interval : 1) {
+    if (!out) throw std::runtime_error("Trace file: cannot create " + path);
+
+    const vector<string>& names = parser.getSymbolNames();
+    const vector<string>& labels = parser.getProductionLabels();
+    vector<Token> tokens(parser.getTokens().begin(), parser.getTokens().end());
+    tokens.push_back(parser.endOfInput());
+
+    // String pool first, so every record below can refer into it
+    string pool;
+    auto addString = [&](const string& s) {
+        TraceStringRef ref = { static_cast<uint32_t>(pool.size()), static_cast<uint32_t>(s.size()) };
+        pool += s;
+        return ref;
+    };
+
+    vector<TraceStringRef> symbolRecords;
+    for (const string& name : names) symbolRecords.push_back(addString(name));
+
+    vector<TraceProductionRecord> productionRecords;
+    vector<Symbol> rhsSymbols;
+    for (size_t i = 0; i < labels.size(); i++) {
+        productionRhs.push_back(parser.productionRhs(i));
+        productionRecords.push_back({ static_cast<uint32_t>(rhsSymbols.size()),
+                                      static_cast<uint16_t>(productionRhs[i].size()), 0, addString(labels[i]) });
+        rhsSymbols.insert(rhsSymbols.end(), productionRhs[i].begin(), productionRhs[i].end());
+    }
+
+    vector<TraceTokenRecord> tokenRecords;
+    for (const Token& t : tokens) {
+        tokenRecords.push_back({ static_cast<uint32_t>(t.type), 0, t.offset, addString(t.value) });
+    }
+
+    memcpy(header.magic, TRACE_MAGIC, 4);
+    header.version = TRACE_VERSION;
+    header.symbolCount = static_cast<uint32_t>(names.size());
+    header.productionCount = static_cast<uint32_t>(labels.size());
+    header.tokenCount = static_cast<uint32_t>(tokens.size());
+    header.keyframeInterval = keyframeInterval;
+
+    writeRaw(out, &header, 1);      // placeholder, rewritten by finish()
+    header.stringsOffset = alignOutput(out);
+    out.write(pool.data(), static_cast<streamsize>(pool.size()));
+    header.symbolsOffset = alignOutput(out);
+    writeRaw(out, symbolRecords.data(), symbolRecords.size());
+    header.productionsOffset = alignOutput(out);
+    writeRaw(out, productionRecords.data(), productionRecords.size());
+    header.rhsOffset = alignOutput(out);
+    writeRaw(out, rhsSymbols.data(), rhsSymbols.size());
+    header.tokensOffset = alignOutput(out);
+    writeRaw(out, tokenRecords.data(), tokenRecords.size());
+    header.stepsOffset = alignOutput(out);
+}
+
+
+TraceFileWriter::~TraceFileWriter() {
+    try {
+        finish();
+    } catch (const std::runtime_error&) {
+        // Nothing sensible to report from a destructor
+    }
+}
+
+
+void TraceFileWriter::append(const PDAAction& step) {
+    // The tables up front are the LL Parser's, so a reduction has nothing
+    // to refer to and no way to be replayed
+    if (step.op == PDAOp::Reduce) throw std::runtime_error("Trace file: cannot store an LR reduction in " + path);
+    applyStep(stack, productionRhs, hasPendingExpand, pendingExpand, step.op, step.arg);
+    hasPendingExpand = step.op == PDAOp::Expand;
+    pendingExpand = step.arg;
+
+    if (header.stepCount % keyframeInterval == 0) {
+        keyframes.push_back({ keyframeSymbols.size(), stack.size() });
+        keyframeSymbols.insert(keyframeSymbols.end(), stack.begin(), stack.end());
+    }
+
+    TraceStepRecord record = { static_cast<uint8_t>(step.op), 0, step.arg, step.tokenIndex };
+    writeRaw(out, &record, 1);
+    header.stepCount++;
+}
+
+
+void TraceFileWriter::finish() {
+    if (finished) return;
+    finished = true;
+
+    header.keyframeCount = keyframes.size();
+    header.keyframesOffset = alignOutput(out);
+    writeRaw(out, keyframes.data(), keyframes.size());
+    header.keyframeSymbolsOffset = alignOutput(out);
+    writeRaw(out, keyframeSymbols.data(), keyframeSymbols.size());
+
+    out.seekp(0);
+    writeRaw(out, &header, 1);
+    out.close();
+    if (!out) throw std::runtime_error("Trace file: write failed for " + path);
+}
+
+
+void writeTraceFile(const string& path, const Parser& parser, uint32_t keyframeInterval) {
+    TraceFileWriter writer(path, parser, keyframeInterval);
+    for (const PDAAction& step : parser.getTrace()) writer.append(step);
+    writer.finish();
+}
+
+
+TraceFile::TraceFile(const string& path) {
+#ifndef _WIN32
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) throw std::runtime_error("Trace file: cannot open " + path);
+    struct stat info;
+    if (fstat(fd, &info) != 0 || info.st_size == 0) {
+        close(fd);
+        throw std::runtime_error("Trace file: cannot read " + path);
+    }
+    size = static_cast<size_t>(info.st_size);
+    void* mapped = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapped == MAP_FAILED) throw std::runtime_error("Trace file: cannot map " + path);
+    data = static_cast<const uint8_t*>(mapped);
+#else
+    ifstream in(path, ios::binary);
+    if (!in) throw std::runtime_error("Trace file: cannot open " + path);
+    fallback.assign(istreambuf_iterator<char>(in), istreambuf_iterator<char>());
+    data = fallback.data();
+    size = fallback.size();
+#endif
+
+    try {
+        validate();
+    } catch (...) {
+        release();
+        throw;
+    }
+}
+
+
+TraceFile::~TraceFile() {
+    release();
+}
+
+
+void TraceFile::release() {
+#ifndef _WIN32
+    if (data) munmap(const_cast<uint8_t*>(data), size);
+#endif
+    data = nullptr;
+}
+
+
+// Whether count records of recordSize bytes fit in the file at offset,
+// without overflowing on counts a corrupt header can hold
+static bool fits(size_t size, uint64_t offset, uint64_t count, size_t recordSize) {
+    return offset <= size && count <= (size - offset) / recordSize;
+}
+
+
+// Everything whose size does not grow with the trace is checked here; steps
+// and keyframes are checked by step() as it reads them, so opening stays as
+// cheap as the header promises
+void TraceFile::validate() const {
+    auto fail = [](const string& why) { throw std::runtime_error("Trace file: " + why); };
+    if (size < sizeof(TraceFileHeader)) fail("truncated header");
+
+    const TraceFileHeader& h = *reinterpret_cast<const TraceFileHeader*>(data);
+    if (memcmp(h.magic, TRACE_MAGIC, 4) != 0) fail("not a trace file");
+    if (h.version != TRACE_VERSION) fail("unsupported version " + to_string(h.version));
+    if (h.keyframeInterval == 0) fail("bad keyframe interval");
+    if (h.tokenCount == 0) fail("no end-of-input token");
+
+    const uint64_t sections[] = { h.stringsOffset, h.symbolsOffset, h.productionsOffset, h.rhsOffset,
+                                  h.tokensOffset, h.stepsOffset, h.keyframesOffset, h.keyframeSymbolsOffset };
+    for (uint64_t offset : sections) {
+        if (offset % 8 || offset > size) fail("section out of range");
+    }
+    if (!fits(size, h.symbolsOffset, h.symbolCount, sizeof(TraceStringRef)) ||
+        !fits(size, h.productionsOffset, h.productionCount, sizeof(TraceProductionRecord)) ||
+        !fits(size, h.tokensOffset, h.tokenCount, sizeof(TraceTokenRecord)) ||
+        !fits(size, h.stepsOffset, h.stepCount, sizeof(TraceStepRecord)) ||
+        !fits(size, h.keyframesOffset, h.keyframeCount, sizeof(TraceKeyframe)) ||
+        h.keyframeCount < (h.stepCount + h.keyframeInterval - 1) / h.keyframeInterval) {
+        fail("section out of range");
+    }
+
+    auto checkString = [&](const TraceStringRef& ref) {
+        if (!fits(size, h.stringsOffset, uint64_t(ref.offset) + ref.length, 1)) fail("string out of range");
+    };
+    const TraceStringRef* symbols = reinterpret_cast<const TraceStringRef*>(data + h.symbolsOffset);
+    for (uint32_t i = 0; i < h.symbolCount; i++) checkString(symbols[i]);
+
+    const TraceProductionRecord* productions = reinterpret_cast<const TraceProductionRecord*>(data + h.productionsOffset);
+    const Symbol* rhsSymbols = reinterpret_cast<const Symbol*>(data + h.rhsOffset);
+    for (uint32_t i = 0; i < h.productionCount; i++) {
+        const TraceProductionRecord& p = productions[i];
+        checkString(p.label);
+        if (!fits(size, h.rhsOffset, uint64_t(p.rhsFirst) + p.rhsLength, sizeof(Symbol))) fail("production out of range");
+        for (uint32_t k = 0; k < p.rhsLength; k++) {
+            if (rhsSymbols[p.rhsFirst + k] >= h.symbolCount) fail("bad symbol in production " + to_string(i));
+        }
+    }
+
+    const TraceTokenRecord* tokens = reinterpret_cast<const TraceTokenRecord*>(data + h.tokensOffset);
+    for (uint32_t i = 0; i < h.tokenCount; i++) checkString(tokens[i].value);
+}
+
+
+size_t TraceFile::stepCount() const {
+    return reinterpret_cast<const TraceFileHeader*>(data)->stepCount;
+}
+
+
+string TraceFile::readString(uint64_t offset, uint32_t length) const {
+    const TraceFileHeader& h = *reinterpret_cast<const TraceFileHeader*>(data);
+    return string(reinterpret_cast<const char*>(data + h.stringsOffset + offset), length);
+}
+
+
+ReplayStep TraceFile::step(size_t n) const {
+    const TraceFileHeader& h = *reinterpret_cast<const TraceFileHeader*>(data);
+    if (n >= h.stepCount) throw std::out_of_range("Trace file: no step " + to_string(n));
+    auto corrupt = [n](const string& why) { throw std::runtime_error("Trace file: " + why + " replaying step " + to_string(n)); };
+
+    const TraceStringRef* symbols = reinterpret_cast<const TraceStringRef*>(data + h.symbolsOffset);
+    const TraceProductionRecord* productions = reinterpret_cast<const TraceProductionRecord*>(data + h.productionsOffset);
+    const Symbol* rhsSymbols = reinterpret_cast<const Symbol*>(data + h.rhsOffset);
+    const TraceTokenRecord* tokens = reinterpret_cast<const TraceTokenRecord*>(data + h.tokensOffset);
+    const TraceStepRecord* steps = reinterpret_cast<const TraceStepRecord*>(data + h.stepsOffset);
+    const TraceKeyframe* keyframes = reinterpret_cast<const TraceKeyframe*>(data + h.keyframesOffset);
+    const Symbol* keyframeSymbols = reinterpret_cast<const Symbol*>(data + h.keyframeSymbolsOffset);
+
+    // Start from the nearest keyframe at or before n and roll forward
+    size_t first = n - n % h.keyframeInterval;
+    const TraceKeyframe& key = keyframes[first / h.keyframeInterval];
+    if (key.depth > UINT64_MAX - key.firstSymbol ||
+        !fits(size, h.keyframeSymbolsOffset, key.firstSymbol + key.depth, sizeof(Symbol))) {
+        corrupt("keyframe out of range");
+    }
+    vector<Symbol> stack(keyframeSymbols + key.firstSymbol, keyframeSymbols + key.firstSymbol + key.depth);
+    for (Symbol s : stack) {
+        if (s >= h.symbolCount) corrupt("bad symbol in keyframe");
+    }
+
+    for (size_t i = first; i <= n; i++) {
+        const TraceStepRecord& record = steps[i];
+        switch (static_cast<PDAOp>(record.op)) {
+            case PDAOp::Expand:
+                if (record.arg >= h.productionCount) corrupt("bad production");
+                break;
+            case PDAOp::Push:
+            case PDAOp::Match:
+                if (record.arg >= h.symbolCount) corrupt("bad symbol");
+                break;
+            case PDAOp::Accept:
+            case PDAOp::Error:
+                break;
+            default:
+                corrupt("bad operation");
+        }
+        if (i == first) continue;
+
+        const TraceStepRecord& previous = steps[i - 1];
+        if (previous.op == static_cast<uint8_t>(PDAOp::Expand)) {
+            const TraceProductionRecord& p = productions[previous.arg];
+            if (stack.empty()) corrupt("expansion of an empty stack");
+            stack.pop_back();
+            for (size_t k = p.rhsLength; k > 0; k--) stack.push_back(rhsSymbols[p.rhsFirst + k - 1]);
+        }
+        PDAOp op = static_cast<PDAOp>(record.op);
+        if (op == PDAOp::Match) {
+            if (stack.empty()) corrupt("match on an empty stack");
+            stack.pop_back();
+        } else if (op == PDAOp::Push) {
+            stack.push_back(record.arg);
+        }
+    }
+
+    const TraceStepRecord& record = steps[n];
+    const TraceTokenRecord& token = tokens[record.tokenIndex < h.tokenCount ? record.tokenIndex : h.tokenCount - 1];
+    auto symbolName = [&](Symbol s) { return readString(symbols[s].offset, symbols[s].length); };
+
+    ReplayStep result = { {}, Token{ static_cast<TokenType>(token.type), readString(token.value.offset, token.value.length), token.offset },
+                          "", static_cast<PDAOp>(record.op), record.arg };
+    for (Symbol s : stack) result.stack.push_back(symbolName(s));
+
+    switch (result.op) {
+        case PDAOp::Push:   result.action = "push " + symbolName(record.arg); break;
+        case PDAOp::Expand: result.action = readString(productions[record.arg].label.offset, productions[record.arg].label.length); break;
+        case PDAOp::Match:  result.action = "match " + symbolName(record.arg) + " → pop"; break;
+        case PDAOp::Accept: result.action = "ACCEPTED"; break;
+        case PDAOp::Error:  result.action = "ERROR"; break;
+        default: break;     // rejected above
+    }
+    return result;
+}
@@ -0,0 +1,104 @@
+#ifndef TRACE_FILE_H
+#define TRACE_FILE_H
+
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+#include "syntactic.h"
+
+using namespace std;
+
+// Binary PDA trace files. Each step is a fixed 8-byte record (op, arg, token
+// index) that says how the stack changed, not what it holds; every
+// keyframeInterval steps the full stack is stored as a keyframe. Symbol
+// names, production labels and the token list are stored once up front, so
+// any step can be rebuilt from the nearest keyframe without the Parser.
+// Files are written in host byte order.
+
+// On-disk layout: header, string pool, symbol names, productions, rhs
+// symbols, tokens, steps, keyframe index, keyframe symbols. Sections start
+// at 8-byte aligned offsets.
+struct TraceFileHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t symbolCount;
+    uint32_t productionCount;
+    uint32_t tokenCount;          // including the end-of-input token
+    uint32_t keyframeInterval;
+    uint64_t stepCount;
+    uint64_t keyframeCount;
+    uint64_t stringsOffset;
+    uint64_t symbolsOffset;
+    uint64_t productionsOffset;
+    uint64_t rhsOffset;
+    uint64_t tokensOffset;
+    uint64_t stepsOffset;
+    uint64_t keyframesOffset;
+    uint64_t keyframeSymbolsOffset;
+};
+
+struct TraceKeyframe {
+    uint64_t firstSymbol;         // index into the keyframe symbol section
+    uint64_t depth;
+};
+
+// Streams steps to disk as they are produced; the header and keyframe index
+// are written by finish() (or the destructor). Traces come from Parser: a
+// Reduce step, as LRParser produces, throws runtime_error.
+class TraceFileWriter {
+public:
+    TraceFileWriter(const string& path, const Parser& parser, uint32_t keyframeInterval = 256);
+    ~TraceFileWriter();
+
+    TraceFileWriter(const TraceFileWriter&) = delete;
+    TraceFileWriter& operator=(const TraceFileWriter&) = delete;
+
+    void append(const PDAAction& step);
+    void finish();
+
+private:
+    ofstream out;
+    string path;
+    uint32_t keyframeInterval;
+    bool finished = false;
+
+    vector<vector<Symbol>> productionRhs;
+    vector<Symbol> stack;                 // replica, kept only for keyframes
+    bool hasPendingExpand = false;
+    uint16_t pendingExpand = 0;
+
+    vector<TraceKeyframe> keyframes;
+    vector<Symbol> keyframeSymbols;
+
+    TraceFileHeader header = {};
+};
+
+void writeTraceFile(const string& path, const Parser& parser, uint32_t keyframeInterval = 256);
+
+// Memory-maps a trace file for random access; opening costs the same for a
+// thousand steps or a hundred million. Throws runtime_error on bad files:
+// when opening for a bad layout, string or production, and from step() for
+// a bad keyframe or step record on the way to the step asked for.
+class TraceFile {
+public:
+    explicit TraceFile(const string& path);
+    ~TraceFile();
+
+    TraceFile(const TraceFile&) = delete;
+    TraceFile& operator=(const TraceFile&) = delete;
+
+    size_t stepCount() const;
+    ReplayStep step(size_t n) const;
+
+private:
+    const uint8_t* data = nullptr;
+    size_t size = 0;
+    vector<uint8_t> fallback;     // used where mmap is unavailable
+
+    string readString(uint64_t offset, uint32_t length) const;
+    void validate() const;
+    void release();
+};
+
+#endif
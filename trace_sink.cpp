@@ -0,0 +1,78 @@
+#include <stdexcept>
+#include "trace_sink.h"
+
+using namespace std;
+
+
+RingTraceSink::RingTraceSink(size_t capacity) {
+    if (capacity == 0) throw std::runtime_error("RingTraceSink needs a capacity of at least one step");
+    slots.assign(capacity, ReplayStep{{}, Token(UNKNOWN, "", 0), "", PDAOp::Push, 0});
+}
+
+
+void RingTraceSink::onStep(const PDAAction& step) {
+    ReplayStep& slot = slots[seen % slots.size()];
+    seen++;
+
+    // Refill in place so a wrapped ring stops allocating once the slot
+    // vectors have grown to the usual stack depth
+    slot.stack.resize(step.stackTop ? step.stackTop->depth : 0);
+    size_t i = slot.stack.size();
+    for (const StackNode* n = step.stackTop; n; n = n->below) slot.stack[--i] = *n->symbol;
+
+    slot.currentToken = *step.currentToken;
+    slot.action = *step.action;
+    slot.op = step.op;
+    slot.arg = step.arg;
+}
+
+
+void RingTraceSink::onError(const PDAAction& failedAt, const string& message) {
+    onStep(failedAt);
+    hasError = true;
+    error = message;
+}
+
+
+size_t RingTraceSink::size() const {
+    return min(seen, slots.size());
+}
+
+
+const ReplayStep& RingTraceSink::step(size_t n) const {
+    if (n >= size()) throw std::runtime_error("Trace step out of range");
+    size_t oldest = seen - size();
+    return slots[(oldest + n) % slots.size()];
+}
+
+
+void CountingTraceSink::onStep(const PDAAction& step) {
+    total++;
+    perOp[static_cast<size_t>(step.op)]++;
+    if (step.stackTop && step.stackTop->depth > deepest) deepest = step.stackTop->depth;
+}
+
+
+void CountingTraceSink::onError(const PDAAction& failedAt, const string&) {
+    onStep(failedAt);
+}
+
+
+FileTraceSink::FileTraceSink(const string& path, const Parser& parser, uint32_t keyframeInterval)
+    : writer(path, parser, keyframeInterval) {}
+
+
+void FileTraceSink::onError(const PDAAction& failedAt, const string&) {
+    try {
+        writer.append(failedAt);
+        writer.finish();
+    } catch (const std::exception& e) {
+        writeError = e.what();
+    }
+}
+
+
+void FileTraceSink::finish() {
+    if (!writeError.empty()) throw std::runtime_error(writeError);
+    writer.finish();
+}
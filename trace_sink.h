@@ -0,0 +1,75 @@
+#ifndef TRACE_SINK_H
+#define TRACE_SINK_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "pda_tracer.h"
+#include "trace_file.h"
+
+using namespace std;
+
+// Ready-made TraceSinks for Parser::parse(TraceSink&). MemoryTraceSink, the
+// one the Syntactic tab uses, lives in pda_tracer.h.
+
+// Keeps only the last `capacity` steps, e.g. to show how a long parse ended
+// or failed. Steps are copied out while their stack is still valid, into
+// slots that are reused once the ring wraps.
+class RingTraceSink : public TraceSink {
+public:
+    explicit RingTraceSink(size_t capacity);
+
+    void onStep(const PDAAction& step) override;
+    void onError(const PDAAction& failedAt, const string& message) override;
+
+    size_t size() const;                     // steps held, at most capacity
+    size_t totalSteps() const { return seen; }
+    const ReplayStep& step(size_t n) const;  // 0 = oldest step still held
+
+    bool failed() const { return hasError; }
+    const string& errorMessage() const { return error; }
+
+private:
+    vector<ReplayStep> slots;
+    size_t seen = 0;
+    bool hasError = false;
+    string error;
+};
+
+// Statistics only: no step is kept
+class CountingTraceSink : public TraceSink {
+public:
+    void onStep(const PDAAction& step) override;
+    void onError(const PDAAction& failedAt, const string& message) override;
+
+    size_t steps() const { return total; }
+    size_t count(PDAOp op) const { return perOp[static_cast<size_t>(op)]; }
+    size_t maxDepth() const { return deepest; }
+
+private:
+    size_t total = 0;
+    size_t perOp[static_cast<size_t>(PDAOp::Reduce) + 1] = {};
+    size_t deepest = 0;
+};
+
+// Writes steps to a trace file as they happen, so a trace never has to fit
+// in memory. A failed parse ends the file with an Error step. Only Parser
+// traces can be written; see TraceFileWriter.
+class FileTraceSink : public TraceSink {
+public:
+    FileTraceSink(const string& path, const Parser& parser, uint32_t keyframeInterval = 256);
+
+    void onStep(const PDAAction& step) override { writer.append(step); }
+
+    // Runs inside the parser's error handling, so it never throws: a failed
+    // write is kept and thrown by finish() instead of hiding the syntax error
+    void onError(const PDAAction& failedAt, const string& message) override;
+
+    void finish();
+
+private:
+    TraceFileWriter writer;
+    string writeError;
+};
+
+#endif